@@ -0,0 +1,462 @@
+//***********************************************************************
+//
+//  Kim-1 MicroChess (c) 1976-2005 Peter Jennings, www.benlo.com
+//  6502 emulation   (c) 2005 Bill Forster
+//
+//  Benchmark, runs GO on each position of a corpus at each level and
+//  reports wall time, JANUS and CMOVE calls and the move chosen as CSV
+//  or JSON, optionally compared with an earlier CSV run. With -m times
+//  the individual routines of the search on each position instead
+//
+//  Usage: microchess-bench [-m] [-l levels] [-r repeats] [-t threads]
+//                  [-H hash_mb] [-g 6502|bitboard|compare] [-f csv|json]
+//                  [-n native|6502|compare] [-p pruned|full|compare]
+//                  [-b baseline.csv] corpus
+//
+//***********************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "microchess.h"
+
+#define MAX_RESULTS 1024
+#define MAX_NAME    64
+
+// One GO, a position at a level
+typedef struct result
+{
+    char name[MAX_NAME];
+    int level;
+    char move[5];
+    int value;
+    unsigned long long janus;
+    unsigned long long cmove;
+    double seconds;         // median of the repeats
+} result;
+
+static result results[MAX_RESULTS];
+static int nresults;
+
+// One routine timed on a position (-m)
+typedef struct micro
+{
+    char name[MAX_NAME];
+    mc_timing timing;
+} micro;
+
+static micro micros[MAX_RESULTS];
+static int nmicros;
+
+// Seconds since some fixed time
+static double seconds( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return( ts.tv_sec + ts.tv_nsec*1e-9 );
+}
+
+static int compare_double( const void *a, const void *b )
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return( x<y ? -1 : x>y ? 1 : 0 );
+}
+
+// Set up a corpus position, the moves in "moves" from the initial
+//  position, with the side to move as the computer and the opening book
+//  off. Returns 0 if a move can't be made
+static int setup( mc_engine *mc, char *moves )
+{
+    unsigned char squares[MC_PIECES], from, to;
+    char *text;
+    int n = 0, reversed;
+
+    mc_new_game( mc, 1 );
+    for( text=strtok(moves," \t\r\n"); text; text=strtok(NULL," \t\r\n") )
+    {
+        if( strlen(text) != 4 || MC_OK != mc_parse_move(mc,text,&from,&to)
+                              || MC_OK != mc_apply_move(mc,from,to) )
+            return( 0 );
+        n++;
+    }
+    if( n & 1 )
+        mc_reverse( mc );   // black to move
+    reversed = mc_get_position( mc, squares );
+    mc_set_position( mc, squares, reversed );
+    return( 1 );
+}
+
+// Run GO on one position at one level "repeats" times
+static int run( mc_engine *mc, const char *name, const char *moves,
+                                                    int level, int repeats )
+{
+    double times[101], start;
+    char buf[1024];
+    result *r;
+    mc_move best;
+    mc_stats stats;
+    int i;
+
+    if( nresults >= MAX_RESULTS )
+        return( 0 );
+    r = &results[nresults];
+    for( i=0; i<repeats; i++ )
+    {
+        strcpy( buf, moves );
+        if( !setup(mc,buf) )
+        {
+            fprintf( stderr, "%s: illegal move\n", name );
+            return( 0 );
+        }
+        mc_set_level( mc, level );
+        mc_clear_hash( mc );        // as a first search of the position
+        start = seconds();
+        if( MC_OK != mc_go(mc,&best) )
+            strcpy( r->move, "none" );
+        else
+            mc_move_text( mc, &best, r->move );
+        times[i] = seconds() - start;
+    }
+    mc_get_stats( mc, &stats );
+    qsort( times, repeats, sizeof(double), compare_double );
+    snprintf( r->name, MAX_NAME, "%s", name );
+    r->level   = level;
+    r->value   = best.value;
+    r->janus   = stats.janus;
+    r->cmove   = stats.cmove;
+    r->seconds = times[repeats/2];
+    nresults++;
+    return( 1 );
+}
+
+// Time each routine on one position, "samples" samples each
+static int run_micro( mc_engine *mc, const char *name, const char *moves,
+                                                            int samples )
+{
+    char buf[1024];
+    mc_timing timing;
+    int which;
+
+    strcpy( buf, moves );
+    if( !setup(mc,buf) )
+    {
+        fprintf( stderr, "%s: illegal move\n", name );
+        return( 0 );
+    }
+    for( which=0; nmicros<MAX_RESULTS &&
+                    MC_OK==mc_microbench(mc,which,samples,&timing); which++ )
+    {
+        snprintf( micros[nmicros].name, MAX_NAME, "%s", name );
+        micros[nmicros++].timing = timing;
+    }
+    return( 1 );
+}
+
+static void print_csv( void )
+{
+    int i;
+    printf( "name,level,move,value,janus,cmove,seconds\n" );
+    for( i=0; i<nresults; i++ )
+    {
+        result *r = &results[i];
+        printf( "%s,%d,%s,%d,%llu,%llu,%.6f\n", r->name, r->level, r->move,
+                                r->value, r->janus, r->cmove, r->seconds );
+    }
+}
+
+static void print_micro_csv( void )
+{
+    int i;
+    printf( "name,routine,ops,ns_per_op,ns_stddev,ns_min\n" );
+    for( i=0; i<nmicros; i++ )
+    {
+        mc_timing *t = &micros[i].timing;
+        printf( "%s,%s,%lu,%.2f,%.2f,%.2f\n", micros[i].name, t->name,
+                            t->ops, t->ns_per_op, t->ns_stddev, t->ns_min );
+    }
+}
+
+static void print_micro_json( void )
+{
+    int i;
+    printf( "[\n" );
+    for( i=0; i<nmicros; i++ )
+    {
+        mc_timing *t = &micros[i].timing;
+        printf( "  {\"name\": \"%s\", \"routine\": \"%s\", \"ops\": %lu, "
+                "\"ns_per_op\": %.2f, \"ns_stddev\": %.2f, \"ns_min\": %.2f}"
+                "%s\n", micros[i].name, t->name, t->ops, t->ns_per_op,
+                t->ns_stddev, t->ns_min, i+1<nmicros ? "," : "" );
+    }
+    printf( "]\n" );
+}
+
+static void print_json( void )
+{
+    int i;
+    printf( "[\n" );
+    for( i=0; i<nresults; i++ )
+    {
+        result *r = &results[i];
+        printf( "  {\"name\": \"%s\", \"level\": %d, \"move\": \"%s\", "
+                "\"value\": %d, \"janus\": %llu, \"cmove\": %llu, "
+                "\"seconds\": %.6f}%s\n", r->name, r->level, r->move,
+                r->value, r->janus, r->cmove, r->seconds,
+                i+1<nresults ? "," : "" );
+    }
+    printf( "]\n" );
+}
+
+// Compare with an earlier CSV run, on stderr. Returns the number of
+//  positions where the move chosen has changed
+static int compare( const char *path )
+{
+    FILE *f = fopen( path, "r" );
+    char line[256], name[MAX_NAME], move[8];
+    int i, level, value, matched=0, changed=0;
+    unsigned long long janus, cmove;
+    double secs, base_total=0, total=0;
+
+    if( f == NULL )
+    {
+        fprintf( stderr, "Can't open baseline %s\n", path );
+        return( 1 );
+    }
+    fprintf( stderr, "%-12s %5s %6s %10s %10s %7s\n", "name", "level",
+                                    "move", "baseline", "now", "speedup" );
+    while( fgets(line,sizeof(line),f) )
+    {
+        if( 7 != sscanf( line, "%63[^,],%d,%7[^,],%d,%llu,%llu,%lf", name,
+                            &level, move, &value, &janus, &cmove, &secs ) )
+            continue;   // header
+        for( i=0; i<nresults; i++ )
+        {
+            result *r = &results[i];
+            if( r->level!=level || 0!=strcmp(r->name,name) )
+                continue;
+            matched++;
+            base_total += secs;
+            total      += r->seconds;
+            fprintf( stderr, "%-12s %5d %6s %10.6f %10.6f %6.2fx%s%s\n",
+                    name, level, r->move, secs, r->seconds,
+                    r->seconds>0 ? secs/r->seconds : 0.0,
+                    strcmp(r->move,move) ? "  MOVE WAS " : "",
+                    strcmp(r->move,move) ? move : "" );
+            if( strcmp(r->move,move) )
+                changed++;
+            else if( r->janus!=janus || r->cmove!=cmove )
+                fprintf( stderr, "%-12s %5d  counts were %llu,%llu now"
+                        " %llu,%llu\n", name, level, janus, cmove, r->janus,
+                        r->cmove );
+        }
+    }
+    fclose( f );
+    fprintf( stderr, "%d positions compared, %d moves changed",
+                                                        matched, changed );
+    if( total > 0 )
+        fprintf( stderr, ", total %.3fs was %.3fs, %.2fx", total,
+                                                base_total, base_total/total );
+    fprintf( stderr, "\n" );
+    return( changed );
+}
+
+// Compare routine timings with an earlier -m CSV run, on stderr, per
+//  position and then per routine over the whole corpus
+static void compare_micro( const char *path )
+{
+    FILE *f = fopen( path, "r" );
+    char line[256], name[MAX_NAME], routine[MAX_NAME];
+    const char *routines[MAX_RESULTS];
+    double base[MAX_RESULTS], now[MAX_RESULTS];
+    double ns, stddev, min;
+    unsigned long ops;
+    int i, j, nroutines=0;
+
+    if( f == NULL )
+    {
+        fprintf( stderr, "Can't open baseline %s\n", path );
+        return;
+    }
+    fprintf( stderr, "%-12s %-14s %10s %10s %7s\n", "name", "routine",
+                                    "baseline", "now", "speedup" );
+    while( fgets(line,sizeof(line),f) )
+    {
+        if( 6 != sscanf( line, "%63[^,],%63[^,],%lu,%lf,%lf,%lf", name,
+                                    routine, &ops, &ns, &stddev, &min ) )
+            continue;   // header
+        for( i=0; i<nmicros; i++ )
+        {
+            mc_timing *t = &micros[i].timing;
+            if( strcmp(micros[i].name,name) || strcmp(t->name,routine) )
+                continue;
+            fprintf( stderr, "%-12s %-14s %10.2f %10.2f %6.2fx\n", name,
+                routine, ns, t->ns_per_op, ns/t->ns_per_op );
+            for( j=0; j<nroutines && strcmp(routines[j],t->name); j++ )
+                ;
+            if( j == nroutines )
+            {
+                routines[nroutines++] = t->name;
+                base[j] = now[j] = 0;
+            }
+            base[j] += ns;
+            now [j] += t->ns_per_op;
+        }
+    }
+    fclose( f );
+    for( j=0; j<nroutines; j++ )
+        fprintf( stderr, "%-14s %6.2fx over the corpus\n", routines[j],
+                                                        base[j]/now[j] );
+}
+
+static int usage( void )
+{
+    fprintf( stderr, "Usage: microchess-bench [-m] [-l levels] [-r repeats]"
+                     " [-t threads]\n"
+                     "          [-H hash_mb] [-g 6502|bitboard|compare]"
+                     " [-f csv|json]\n"
+                     "          [-n native|6502|compare]"
+                     " [-p pruned|full|compare]\n"
+                     "          [-b baseline.csv] corpus\n" );
+    return( 1 );
+}
+
+int main( int argc, char* argv[] )
+{
+    int i, repeats=11, threads=1, generator=MC_GEN_6502, json=0, ret=0;
+    int bool_micro=0, hash=MC_HASH_DEFAULT, native=MC_NATIVE_ON;
+    int pruning=MC_PRUNE_ON;
+    const char *levels="123", *baseline=NULL, *corpus=NULL, *l;
+    char line[1024], name[MAX_NAME], *moves;
+    mc_engine *mc;
+    FILE *f;
+
+    // Options
+    for( i=1; i<argc; i++ )
+    {
+        if( 0==strcmp(argv[i],"-m") )
+            bool_micro = 1;
+        else if( 0==strcmp(argv[i],"-l") && i+1<argc )
+            levels = argv[++i];
+        else if( 0==strcmp(argv[i],"-r") && i+1<argc )
+            repeats = atoi( argv[++i] );
+        else if( 0==strcmp(argv[i],"-t") && i+1<argc )
+            threads = atoi( argv[++i] );
+        else if( 0==strcmp(argv[i],"-H") && i+1<argc )
+            hash = atoi( argv[++i] );
+        else if( 0==strcmp(argv[i],"-g") && i+1<argc )
+        {
+            i++;
+            if( 0==strcmp(argv[i],"6502") )
+                generator = MC_GEN_6502;
+            else if( 0==strcmp(argv[i],"bitboard") )
+                generator = MC_GEN_BITBOARD;
+            else if( 0==strcmp(argv[i],"compare") )
+                generator = MC_GEN_COMPARE;
+            else
+                return( usage() );
+        }
+        else if( 0==strcmp(argv[i],"-n") && i+1<argc )
+        {
+            i++;
+            if( 0==strcmp(argv[i],"native") )
+                native = MC_NATIVE_ON;
+            else if( 0==strcmp(argv[i],"6502") )
+                native = MC_NATIVE_OFF;
+            else if( 0==strcmp(argv[i],"compare") )
+                native = MC_NATIVE_COMPARE;
+            else
+                return( usage() );
+        }
+        else if( 0==strcmp(argv[i],"-p") && i+1<argc )
+        {
+            i++;
+            if( 0==strcmp(argv[i],"pruned") )
+                pruning = MC_PRUNE_ON;
+            else if( 0==strcmp(argv[i],"full") )
+                pruning = MC_PRUNE_OFF;
+            else if( 0==strcmp(argv[i],"compare") )
+                pruning = MC_PRUNE_COMPARE;
+            else
+                return( usage() );
+        }
+        else if( 0==strcmp(argv[i],"-f") && i+1<argc )
+            json = (0==strcmp(argv[++i],"json"));
+        else if( 0==strcmp(argv[i],"-b") && i+1<argc )
+            baseline = argv[++i];
+        else if( argv[i][0] != '-' && corpus == NULL )
+            corpus = argv[i];
+        else
+            return( usage() );
+    }
+    if( corpus == NULL || repeats < 1 || repeats > 101 )
+        return( usage() );
+    f = fopen( corpus, "r" );
+    if( f == NULL )
+    {
+        fprintf( stderr, "Can't open corpus %s\n", corpus );
+        return( 1 );
+    }
+    mc = mc_create();
+    if( mc == NULL || MC_OK != mc_set_threads(mc,threads)
+                   || MC_OK != mc_set_generator(mc,generator)
+                   || MC_OK != mc_set_native(mc,native)
+                   || MC_OK != mc_set_pruning(mc,pruning)
+                   || MC_OK != mc_set_hash(mc,hash) )
+    {
+        fprintf( stderr, "Can't create engine\n" );
+        return( 1 );
+    }
+
+    // Each position at each level
+    while( fgets(line,sizeof(line),f) )
+    {
+        if( 1 != sscanf(line,"%63s",name) || name[0]=='#' )
+            continue;
+        moves = strstr( line, name ) + strlen( name );
+        if( bool_micro )
+        {
+            if( !run_micro( mc, name, moves, repeats ) )
+                ret = 1;
+            continue;
+        }
+        for( l=levels; *l; l++ )
+        {
+            if( !run( mc, name, moves, *l-'0', repeats ) )
+                ret = 1;
+        }
+    }
+    fclose( f );
+    if( mc_native_mismatches(mc) )
+    {
+        fprintf( stderr, "%ld native mismatches\n", mc_native_mismatches(mc) );
+        ret = 1;
+    }
+    if( mc_pruning_mismatches(mc) )
+    {
+        fprintf( stderr, "%ld pruning mismatches\n",
+                                            mc_pruning_mismatches(mc) );
+        ret = 1;
+    }
+    mc_destroy( mc );
+
+    if( bool_micro )
+    {
+        if( json )
+            print_micro_json();
+        else
+            print_micro_csv();
+        if( baseline )
+            compare_micro( baseline );
+    }
+    else
+    {
+        if( json )
+            print_json();
+        else
+            print_csv();
+        if( baseline && compare(baseline) )
+            ret = 1;
+    }
+    return( ret );
+}
@@ -0,0 +1,222 @@
+//***********************************************************************
+//
+//  Kim-1 MicroChess (c) 1976-2005 Peter Jennings, www.benlo.com
+//  6502 emulation   (c) 2005 Bill Forster
+//
+//  Opening book builder. Reads lines of play from the initial position,
+//  one per text line in coordinates (eg "e2e4 e7e5 g1f3"), and writes the
+//  book file mc_set_book() maps, see Part 18 of microchess.c. Each time a
+//  line passes through a position, the move it plays there gains weight
+//  1, so lines sharing their first moves make those moves more likely
+//
+//  Usage: microchess-book [-o book_file] lines_file
+//
+//***********************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "microchess.h"
+
+#define MAX_LINE    1024
+#define MAX_WEIGHT  0xffff
+
+// One position and move of the book
+typedef struct entry
+{
+    unsigned long long key;
+    char move[4];
+    unsigned long weight;
+} entry;
+
+static entry *entries;
+static int nentries, size;
+
+// Add a position and move, weight 1
+static int add( unsigned long long key, const char *move )
+{
+    entry *more;
+    int grown;
+
+    if( nentries == size )
+    {
+        grown = size ? size*2 : 1024;
+        more = (entry *)realloc( entries, grown*sizeof(entry) );
+        if( more == NULL )
+        {
+            fprintf( stderr, "Out of memory\n" );
+            return( 0 );
+        }
+        entries = more;
+        size = grown;
+    }
+    entries[nentries].key = key;
+    memcpy( entries[nentries].move, move, 4 );
+    entries[nentries].weight = 1;
+    nentries++;
+    return( 1 );
+}
+
+// Book file order, by key then move
+static int compare( const void *a, const void *b )
+{
+    const entry *x = (const entry *)a, *y = (const entry *)b;
+    if( x->key != y->key )
+        return( x->key < y->key ? -1 : 1 );
+    return( memcmp( x->move, y->move, 4 ) );
+}
+
+// Play one line through from the start, adding each position and move.
+//  Returns 0 if a move can't be played (the rest of the line is skipped),
+//  reported against line "number" of file "path"
+static int play( mc_engine *mc, char *line, const char *path, int number )
+{
+    unsigned char squares[MC_PIECES], from, to;
+    char *move;
+    int i, own;
+
+    mc_new_game( mc, 1 );
+    for( move=strtok(line," \t"); move; move=strtok(NULL," \t") )
+    {
+        if( strlen(move) != 4 || MC_OK != mc_parse_move(mc,move,&from,&to) )
+        {
+            fprintf( stderr, "%s:%d: bad move %s\n", path, number, move );
+            return( 0 );
+        }
+        mc_get_position( mc, squares );
+        for( i=0, own=0; i<MC_PIECES/2; i++ )
+        {
+            if( squares[i] == from )
+                own |= 1;
+            if( squares[i] == to )
+                own |= 2;
+        }
+        if( own != 1 )
+        {
+            fprintf( stderr, "%s:%d: can't play %s\n", path, number,
+                                                                    move );
+            return( 0 );
+        }
+        if( !add( mc_book_key(mc), move ) )
+            return( 0 );
+        mc_apply_move( mc, from, to );
+        mc_reverse( mc );           // the other side to move
+    }
+    return( 1 );
+}
+
+// Write the book file, entries sorted and merged
+static int save( const char *path )
+{
+    FILE *f = fopen( path, "wb" );
+    unsigned char data[16];
+    int i, j, n=0, k;
+
+    if( f == NULL )
+    {
+        fprintf( stderr, "Can't create %s\n", path );
+        return( 0 );
+    }
+    qsort( entries, nentries, sizeof(entry), compare );
+    for( i=0; i<nentries; i++ )
+    {
+        if( n && 0==compare(&entries[n-1],&entries[i]) )
+            entries[n-1].weight += entries[i].weight;
+        else
+            entries[n++] = entries[i];
+    }
+    memset( data, 0, sizeof(data) );
+    memcpy( data, "MCBOOK01", 8 );
+    for( k=0; k<4; k++ )
+        data[8+k] = (unsigned char)(n >> 8*k);
+    fwrite( data, 1, 16, f );
+    for( i=0; i<n; i++ )
+    {
+        if( entries[i].weight > MAX_WEIGHT )
+            entries[i].weight = MAX_WEIGHT;
+        memset( data, 0, sizeof(data) );
+        for( k=0; k<8; k++ )
+            data[k] = (unsigned char)(entries[i].key >> 8*k);
+        memcpy( data+8, entries[i].move, 4 );
+        for( k=0; k<2; k++ )
+            data[12+k] = (unsigned char)(entries[i].weight >> 8*k);
+        fwrite( data, 1, 16, f );
+    }
+    j = ferror( f );
+    if( fclose(f) != 0 || j )
+    {
+        fprintf( stderr, "Can't write %s\n", path );
+        return( 0 );
+    }
+    fprintf( stderr, "%d positions and moves written to %s\n", n, path );
+    return( 1 );
+}
+
+static int usage( void )
+{
+    fprintf( stderr, "Usage: microchess-book [-o book_file] lines_file\n" );
+    return( 1 );
+}
+
+int main( int argc, char* argv[] )
+{
+    const char *path=NULL, *out="book.bin";
+    char line[MAX_LINE], *s;
+    int i, number=0, errors=0, status=1;
+    mc_engine *mc=NULL;
+    FILE *f=NULL;
+
+    // Options
+    for( i=1; i<argc; i++ )
+    {
+        if( 0==strcmp(argv[i],"-o") && i+1<argc )
+            out = argv[++i];
+        else if( argv[i][0] != '-' && path == NULL )
+            path = argv[i];
+        else
+            return( usage() );
+    }
+    if( path == NULL )
+        return( usage() );
+    f = fopen( path, "r" );
+    if( f == NULL )
+    {
+        fprintf( stderr, "Can't open %s\n", path );
+        goto done;
+    }
+    mc = mc_create();
+    if( mc == NULL )
+    {
+        fprintf( stderr, "Can't create engine\n" );
+        goto done;
+    }
+
+    // Each line of play, blank lines and # comments skipped
+    while( fgets(line,sizeof(line),f) )
+    {
+        number++;
+        if( NULL != (s=strchr(line,'#')) )
+            *s = '\0';
+        for( s=line; *s; s++ )
+        {
+            if( isspace((unsigned char)*s) )
+                *s = ' ';
+        }
+        if( !play( mc, line, path, number ) )
+            errors++;
+    }
+    if( errors )
+        fprintf( stderr, "%d bad line%s in %s, %s not written\n", errors,
+                                        errors==1 ? "" : "s", path, out );
+    else if( save( out ) )
+        status = 0;
+
+done:
+    if( mc )
+        mc_destroy( mc );
+    if( f )
+        fclose( f );
+    free( entries );
+    return( status );
+}
@@ -0,0 +1,356 @@
+//***********************************************************************
+//
+//  Kim-1 MicroChess (c) 1976-2005 Peter Jennings, www.benlo.com
+//  6502 emulation   (c) 2005 Bill Forster
+//
+//  Test suite runner, runs GO on each position of an EPD file at one
+//  level, spread over a pool of threads with an engine each, and reports
+//  the move chosen, its value (BESTV), the moves analysed (JANUS calls)
+//  and the time taken as CSV. Positions with a "bm" (or "am") operation
+//  are marked solved or not and a solve rate is given on stderr
+//
+//  Usage: microchess-epd [-l level] [-j jobs] [-H hash_mb]
+//                  [-g 6502|bitboard] epd_file
+//
+//***********************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "microchess.h"
+
+#define MAX_LINE    1024
+#define MAX_JOBS    256
+
+// One position of the suite, and what GO made of it
+typedef struct position
+{
+    char *line;             // the EPD record
+    char id[64];
+    char move[5];           // "none" if there was nothing to play
+    int value;
+    unsigned long long janus;
+    double seconds;
+    int solved;             // 1 yes, 0 no, -1 no bm or am to judge by
+    int error;              // position couldn't be set up
+} position;
+
+static position *positions;
+static int npositions;
+
+// Work shared by the pool
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static int next;
+static int level=MC_LEVEL_NORMAL, generator=MC_GEN_6502, hash=1;
+
+// Seconds since some fixed time
+static double seconds( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return( ts.tv_sec + ts.tv_nsec*1e-9 );
+}
+
+// Copy the value of EPD operation "op" (eg "bm", "id") to "value", quotes
+//  removed. Returns 0 if the record hasn't got one
+static int operation( const char *line, const char *op, char *value,
+                                                                int size )
+{
+    const char *s = line;
+    size_t len = strlen( op );
+    int i=0, n;
+
+    for( n=0; n<4 && *s; n++ )          // skip the four position fields
+    {
+        while( *s && !isspace((unsigned char)*s) )
+            s++;
+        while( isspace((unsigned char)*s) )
+            s++;
+    }
+    while( *s )
+    {
+        if( 0==strncmp(s,op,len) && isspace((unsigned char)s[len]) )
+        {
+            for( s+=len; isspace((unsigned char)*s); s++ )
+                ;
+            for( ; *s && *s!=';' && i<size-1; s++ )
+            {
+                if( *s != '"' )
+                    value[i++] = *s;
+            }
+            value[i] = '\0';
+            return( 1 );
+        }
+        while( *s && *s!=';' )          // next operation
+            s++;
+        while( *s==';' || isspace((unsigned char)*s) )
+            s++;
+    }
+    return( 0 );
+}
+
+// Does the move (piece type and squares, eg 'N', "g1f3") match one move
+//  of the suite, in SAN (eg "Nf3", "exd5", "O-O", "e8=Q+") or coordinates ?
+static int same_move( char type, const char *move, const char *san )
+{
+    char text[8], *s;
+    size_t len;
+
+    if( 0==strncmp(san,move,4) && !isalpha((unsigned char)san[4]) )
+        return( 1 );                    // coordinates
+    strncpy( text, san, sizeof(text)-1 );
+    text[sizeof(text)-1] = '\0';
+    for( s=text; *s && !strchr("+#!?=",*s); s++ )
+        ;
+    *s = '\0';                          // no check, comment or promotion
+    if( 0==strcmp(text,"O-O") || 0==strcmp(text,"0-0") )
+        return( type=='K' && move[0]=='e' && move[2]=='g' );
+    if( 0==strcmp(text,"O-O-O") || 0==strcmp(text,"0-0-0") )
+        return( type=='K' && move[0]=='e' && move[2]=='c' );
+    s = text;
+    if( strchr("KQRBN",*s) )
+    {
+        if( *s++ != type )
+            return( 0 );
+    }
+    else if( type != 'P' )
+        return( 0 );
+    len = strlen( s );
+    if( len < 2 || 0!=strncmp(s+len-2,move+2,2) )
+        return( 0 );                    // destination
+    for( ; len>2; len--, s++ )          // disambiguation, capture
+    {
+        if( *s!='x' && *s!=move[0] && *s!=move[1] )
+            return( 0 );
+    }
+    return( 1 );
+}
+
+// Judge a move against the suite's "bm" moves (any will do) or "am"
+//  moves (none may be played)
+static int judge( position *p, char type )
+{
+    char value[256], *san, *save;
+    int bm;
+
+    bm = operation( p->line, "bm", value, sizeof(value) );
+    if( !bm && !operation(p->line,"am",value,sizeof(value)) )
+        return( -1 );
+    for( san=strtok_r(value," ",&save); san; san=strtok_r(NULL," ",&save) )
+    {
+        if( 0!=strcmp(p->move,"none") && same_move(type,p->move,san) )
+            return( bm );
+    }
+    return( !bm );
+}
+
+// Set up and search one position
+static void solve( mc_engine *mc, position *p )
+{
+    mc_move best;
+    mc_stats stats;
+    double start;
+    char type = '?';
+
+    if( !operation(p->line,"id",p->id,sizeof(p->id)) )
+        p->id[0] = '\0';
+    if( MC_OK != mc_set_fen(mc,p->line) )
+    {
+        p->error = 1;
+        return;
+    }
+    mc_clear_hash( mc );        // the same counts whichever thread runs it
+    start = seconds();
+    if( MC_OK != mc_go(mc,&best) )
+        strcpy( p->move, "none" );
+    else
+    {
+        mc_move_text( mc, &best, p->move );
+        type = "KQRRBBNNPPPPPPPP"[best.piece&0x0f];
+    }
+    p->seconds = seconds() - start;
+    mc_get_stats( mc, &stats );
+    p->value = best.value;
+    p->janus = stats.janus;
+    p->solved = judge( p, type );
+}
+
+// One thread of the pool, its own engine, positions first come first
+//  served
+static void *worker( void *arg )
+{
+    mc_engine *mc = mc_create();
+    int i;
+
+    (void)arg;
+    if( mc == NULL || MC_OK != mc_set_level(mc,level)
+                   || MC_OK != mc_set_generator(mc,generator)
+                   || MC_OK != mc_set_hash(mc,hash) )
+    {
+        fprintf( stderr, "Can't create engine\n" );
+        exit( 1 );
+    }
+    for(;;)
+    {
+        pthread_mutex_lock( &lock );
+        i = next++;
+        pthread_mutex_unlock( &lock );
+        if( i >= npositions )
+            break;
+        solve( mc, &positions[i] );
+    }
+    mc_destroy( mc );
+    return( NULL );
+}
+
+// Read the suite, one position per non blank line
+static int load( const char *path )
+{
+    FILE *f = fopen( path, "r" );
+    char line[MAX_LINE];
+    position *more;
+    int size = 0;
+    size_t len;
+
+    if( f == NULL )
+    {
+        fprintf( stderr, "Can't open %s\n", path );
+        return( 0 );
+    }
+    while( fgets(line,sizeof(line),f) )
+    {
+        len = strlen( line );
+        while( len && isspace((unsigned char)line[len-1]) )
+            line[--len] = '\0';
+        if( len==0 || line[0]=='#' )
+            continue;
+        if( npositions == size )
+        {
+            more = (position *)realloc( positions,
+                                (size ? size*2 : 256)*sizeof(position) );
+            if( more == NULL )
+            {
+                fprintf( stderr, "Out of memory\n" );
+                fclose( f );
+                return( 0 );
+            }
+            positions = more;
+            size = size ? size*2 : 256;
+        }
+        memset( &positions[npositions], 0, sizeof(position) );
+        positions[npositions].line = strdup( line );
+        if( positions[npositions].line == NULL )
+        {
+            fprintf( stderr, "Out of memory\n" );
+            fclose( f );
+            return( 0 );
+        }
+        npositions++;
+    }
+    fclose( f );
+    return( 1 );
+}
+
+static int usage( void )
+{
+    fprintf( stderr, "Usage: microchess-epd [-l level] [-j jobs]"
+                     " [-H hash_mb] [-g 6502|bitboard] epd_file\n" );
+    return( 1 );
+}
+
+int main( int argc, char* argv[] )
+{
+    pthread_t threads[MAX_JOBS];
+    int i, jobs, started, judged=0, solved=0, errors=0;
+    const char *path=NULL;
+    unsigned long long janus=0;
+    double start, elapsed;
+
+    jobs = (int)sysconf( _SC_NPROCESSORS_ONLN );
+
+    // Options
+    for( i=1; i<argc; i++ )
+    {
+        if( 0==strcmp(argv[i],"-l") && i+1<argc )
+            level = atoi( argv[++i] );
+        else if( 0==strcmp(argv[i],"-j") && i+1<argc )
+            jobs = atoi( argv[++i] );
+        else if( 0==strcmp(argv[i],"-H") && i+1<argc )
+            hash = atoi( argv[++i] );
+        else if( 0==strcmp(argv[i],"-g") && i+1<argc )
+        {
+            i++;
+            if( 0==strcmp(argv[i],"6502") )
+                generator = MC_GEN_6502;
+            else if( 0==strcmp(argv[i],"bitboard") )
+                generator = MC_GEN_BITBOARD;
+            else
+                return( usage() );
+        }
+        else if( argv[i][0] != '-' && path == NULL )
+            path = argv[i];
+        else
+            return( usage() );
+    }
+    if( path==NULL || level<MC_LEVEL_SUPER_BLITZ || level>MC_LEVEL_NORMAL )
+        return( usage() );
+    if( jobs < 1 )
+        jobs = 1;
+    if( jobs > MAX_JOBS )
+        jobs = MAX_JOBS;
+    if( !load(path) )
+        return( 1 );
+
+    // Search them all
+    start = seconds();
+    for( started=0; started<jobs && started<npositions; started++ )
+    {
+        if( 0 != pthread_create( &threads[started], NULL, worker, NULL ) )
+            break;
+    }
+    if( started == 0 )
+        worker( NULL );
+    for( i=0; i<started; i++ )
+        pthread_join( threads[i], NULL );
+    elapsed = seconds() - start;
+
+    // Results, in the order of the suite
+    printf( "id,move,value,janus,seconds,solved\n" );
+    for( i=0; i<npositions; i++ )
+    {
+        position *p = &positions[i];
+        if( p->error )
+        {
+            fprintf( stderr, "Can't set up position %d: %s\n", i+1,
+                                                                p->line );
+            errors++;
+            continue;
+        }
+        printf( "%s,%s,%d,%llu,%.6f,%s\n", p->id[0] ? p->id : "-",
+                p->move, p->value, p->janus, p->seconds,
+                p->solved<0 ? "" : p->solved ? "yes" : "no" );
+        janus += p->janus;
+        if( p->solved >= 0 )
+        {
+            judged++;
+            solved += p->solved;
+        }
+    }
+    fprintf( stderr, "%d positions at level %d on %d threads in %.3fs,"
+                     " %llu JANUS calls", npositions-errors, level,
+                     started ? started : 1, elapsed, janus );
+    if( errors )
+        fprintf( stderr, ", %d not set up", errors );
+    if( judged )
+        fprintf( stderr, ", solved %d of %d (%.1f%%)", solved, judged,
+                                                    100.0*solved/judged );
+    fprintf( stderr, "\n" );
+    for( i=0; i<npositions; i++ )
+        free( positions[i].line );
+    free( positions );
+    return( errors ? 1 : 0 );
+}
@@ -0,0 +1,127 @@
+//***********************************************************************
+//
+//  Kim-1 MicroChess (c) 1976-2005 Peter Jennings, www.benlo.com
+//  6502 emulation   (c) 2005 Bill Forster
+//
+//  Interactive program, plays one game on the console, or with -u talks
+//  a UCI style engine protocol instead
+//
+//  Usage: microchess [-u] [-t threads] [-H hash_mb]
+//                    [-g 6502|bitboard|compare] [-n native|6502|compare]
+//                    [-p pruned|full|compare] [-b book_file]
+//
+//***********************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "microchess.h"
+
+int main( int argc, char* argv[] )
+{
+    int i, ret, threads=1, generator=MC_GEN_6502, hash=MC_HASH_DEFAULT;
+    int protocol=0, native=MC_NATIVE_ON, pruning=MC_PRUNE_ON;
+    const char *book=NULL;
+    mc_engine *mc;
+
+    // Options
+    for( i=1; i<argc; i++ )
+    {
+        if( 0==strcmp(argv[i],"-u") )
+            protocol = 1;
+        else if( 0==strcmp(argv[i],"-t") && i+1<argc )
+            threads = atoi( argv[++i] );
+        else if( 0==strcmp(argv[i],"-H") && i+1<argc )
+            hash = atoi( argv[++i] );
+        else if( 0==strcmp(argv[i],"-g") && i+1<argc )
+        {
+            i++;
+            if( 0==strcmp(argv[i],"6502") )
+                generator = MC_GEN_6502;
+            else if( 0==strcmp(argv[i],"bitboard") )
+                generator = MC_GEN_BITBOARD;
+            else if( 0==strcmp(argv[i],"compare") )
+                generator = MC_GEN_COMPARE;
+            else
+                generator = -1;
+        }
+        else if( 0==strcmp(argv[i],"-n") && i+1<argc )
+        {
+            i++;
+            if( 0==strcmp(argv[i],"native") )
+                native = MC_NATIVE_ON;
+            else if( 0==strcmp(argv[i],"6502") )
+                native = MC_NATIVE_OFF;
+            else if( 0==strcmp(argv[i],"compare") )
+                native = MC_NATIVE_COMPARE;
+            else
+                native = -1;
+        }
+        else if( 0==strcmp(argv[i],"-b") && i+1<argc )
+            book = argv[++i];
+        else if( 0==strcmp(argv[i],"-p") && i+1<argc )
+        {
+            i++;
+            if( 0==strcmp(argv[i],"pruned") )
+                pruning = MC_PRUNE_ON;
+            else if( 0==strcmp(argv[i],"full") )
+                pruning = MC_PRUNE_OFF;
+            else if( 0==strcmp(argv[i],"compare") )
+                pruning = MC_PRUNE_COMPARE;
+            else
+                pruning = -1;
+        }
+        else
+        {
+            fprintf( stderr, "Usage: microchess [-u] [-t threads]"
+                     " [-H hash_mb] [-g 6502|bitboard|compare]"
+                     " [-n native|6502|compare]\n"
+                     "                  [-p pruned|full|compare]"
+                     " [-b book_file]\n" );
+            return( 1 );
+        }
+    }
+
+    mc = mc_create();
+    if( mc == NULL )
+        return( 1 );
+    if( MC_OK != mc_set_threads( mc, threads ) )
+    {
+        fprintf( stderr, "Threads must be 1 to %d\n", MC_MAX_THREADS );
+        mc_destroy( mc );
+        return( 1 );
+    }
+    if( MC_OK != mc_set_hash( mc, hash ) )
+    {
+        fprintf( stderr, "Can't have a %d megabyte hash table\n", hash );
+        mc_destroy( mc );
+        return( 1 );
+    }
+    if( MC_OK != mc_set_generator( mc, generator ) )
+    {
+        fprintf( stderr, "Generator must be 6502, bitboard or compare\n" );
+        mc_destroy( mc );
+        return( 1 );
+    }
+    if( MC_OK != mc_set_native( mc, native ) )
+    {
+        fprintf( stderr, "Native must be native, 6502 or compare\n" );
+        mc_destroy( mc );
+        return( 1 );
+    }
+    if( MC_OK != mc_set_pruning( mc, pruning ) )
+    {
+        fprintf( stderr, "Pruning must be pruned, full or compare\n" );
+        mc_destroy( mc );
+        return( 1 );
+    }
+    if( book && MC_OK != mc_set_book( mc, book ) )
+    {
+        fprintf( stderr, "Can't read book file %s\n", book );
+        mc_destroy( mc );
+        return( 1 );
+    }
+    ret = protocol ? mc_protocol( mc ) : mc_console( mc );
+    mc_destroy( mc );
+    return( ret );
+}
@@ -0,0 +1,831 @@
+//***********************************************************************
+//
+//  Kim-1 MicroChess (c) 1976-2005 Peter Jennings, www.benlo.com
+//  6502 emulation   (c) 2005 Bill Forster
+//
+//  Self-play match runner, plays games between two engine configurations
+//  (level, generator, native routines, capture tree pruning, hash, book
+//  file, clock) over a pool of threads, each thread with an engine of
+//  each configuration. Openings come from an EPD/FEN file, each played
+//  twice with the colours swapped. A referee board of its own follows
+//  every game, so games end by the rules of chess (checkmate, stalemate,
+//  a move leaving the king in check, time) or are adjudicated by
+//  repetition, the fifty move rule, bare kings, a move limit or a
+//  promotion (which microchess can't play). Games go to a PGN file,
+//  results and timing per game to stdout as CSV and the score of the
+//  first configuration to stderr
+//
+//  Usage: microchess-match [-n games] [-j jobs] [-m max_moves]
+//                  [-f openings] [-o pgn_file] config1 config2
+//
+//  A configuration is a comma separated list, eg "level=2,gen=bitboard"
+//  or "level=3,time=60+0.5,book=book.bin", of
+//      name=<text>                   name in the PGN (default the list)
+//      level=1|2|3                   search level (default 3)
+//      gen=6502|bitboard             move generator
+//      native=native|6502            hot routines
+//      prune=pruned|full             capture tree
+//      hash=<megabytes>              transposition table
+//      book=<file>                   opening book file
+//      time=<seconds>[+<increment>]  clock, the level chosen from it
+//
+//***********************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "microchess.h"
+
+#define MAX_LINE    1024
+#define MAX_JOBS    256
+#define MAX_PLIES   2048
+#define MAX_TEXT    256
+
+// One engine configuration
+typedef struct config
+{
+    char name[MAX_TEXT];
+    int level, generator, native, pruning, hash;
+    char book[MAX_TEXT];
+    double time, increment;     // time < 0 for no clock
+} config;
+
+// One game, and how it went
+typedef struct game
+{
+    const char *fen;            // opening, NULL for the initial position
+    int white;                  // configuration playing white, 0 or 1
+    const char *result;         // "1-0", "0-1", "1/2-1/2" or "*" if
+                                //  abandoned, left out of the score
+    char reason[64];            // how it ended
+    int plies;
+    char *moves;                // PGN move text
+    double seconds, think[2];   // whole game, each configuration
+} game;
+
+// Referee's board, piece letters by square (rank*8+file), 0 if empty.
+//  White's pieces are upper case
+typedef struct referee
+{
+    char square[64];
+    int white;                  // white to move
+    int quiet;                  // plies since a capture or pawn move
+    int number;                 // move number
+} referee;
+
+static config configs[2];
+static game *games;
+static int ngames=2, max_moves=150;
+static char **openings;
+static int nopenings;
+
+// Work shared by the pool
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static int next;
+
+// Seconds since some fixed time
+static double seconds( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return( ts.tv_sec + ts.tv_nsec*1e-9 );
+}
+
+// Read a configuration, eg "level=2,gen=bitboard". Returns 0 if it isn't
+//  one
+static int configure( config *c, const char *text )
+{
+    char copy[MAX_TEXT], *item, *value, *save;
+
+    memset( c, 0, sizeof(config) );
+    c->level     = MC_LEVEL_NORMAL;
+    c->generator = MC_GEN_6502;
+    c->native    = MC_NATIVE_ON;
+    c->pruning   = MC_PRUNE_ON;
+    c->hash      = MC_HASH_DEFAULT;
+    c->time      = -1;
+    strncpy( c->name, text, sizeof(c->name)-1 );
+    strncpy( copy, text, sizeof(copy)-1 );
+    copy[sizeof(copy)-1] = '\0';
+    for( item=strtok_r(copy,",",&save); item; item=strtok_r(NULL,",",&save) )
+    {
+        value = strchr( item, '=' );
+        if( value == NULL )
+            return( 0 );
+        *value++ = '\0';
+        if( 0 == strcmp(item,"name") )
+            strncpy( c->name, value, sizeof(c->name)-1 );
+        else if( 0 == strcmp(item,"level") )
+            c->level = atoi( value );
+        else if( 0 == strcmp(item,"gen") )
+            c->generator = 0==strcmp(value,"bitboard") ? MC_GEN_BITBOARD :
+                           0==strcmp(value,"6502")     ? MC_GEN_6502 : -1;
+        else if( 0 == strcmp(item,"native") )
+            c->native = 0==strcmp(value,"native") ? MC_NATIVE_ON :
+                        0==strcmp(value,"6502")   ? MC_NATIVE_OFF : -1;
+        else if( 0 == strcmp(item,"prune") )
+            c->pruning = 0==strcmp(value,"pruned") ? MC_PRUNE_ON :
+                         0==strcmp(value,"full")   ? MC_PRUNE_OFF : -1;
+        else if( 0 == strcmp(item,"hash") )
+            c->hash = atoi( value );
+        else if( 0 == strcmp(item,"book") )
+            strncpy( c->book, value, sizeof(c->book)-1 );
+        else if( 0 == strcmp(item,"time") )
+        {
+            c->time = atof( value );
+            if( NULL != (value=strchr(value,'+')) )
+                c->increment = atof( value+1 );
+            if( c->time <= 0 || c->increment < 0 )
+                return( 0 );
+        }
+        else
+            return( 0 );
+    }
+    return( c->level>=MC_LEVEL_SUPER_BLITZ && c->level<=MC_LEVEL_NORMAL &&
+            c->generator>=0 && c->native>=0 && c->pruning>=0 );
+}
+
+// An engine set up as a configuration, NULL if it can't be
+static mc_engine *engine( const config *c )
+{
+    mc_engine *mc = mc_create();
+    if( mc == NULL )
+        return( NULL );
+    if( MC_OK != mc_set_level(mc,c->level)
+     || MC_OK != mc_set_generator(mc,c->generator)
+     || MC_OK != mc_set_native(mc,c->native)
+     || MC_OK != mc_set_pruning(mc,c->pruning)
+     || MC_OK != mc_set_hash(mc,c->hash)
+     || (c->book[0] && MC_OK != mc_set_book(mc,c->book)) )
+    {
+        mc_destroy( mc );
+        return( NULL );
+    }
+    return( mc );
+}
+
+// Referee, set up from FEN (or EPD). Returns 0 if it can't be
+static int referee_fen( referee *r, const char *fen )
+{
+    int file=0, rank=7, quiet, number, n;
+    const char *s;
+
+    memset( r, 0, sizeof(referee) );
+    for( s=fen; *s && *s!=' '; s++ )
+    {
+        if( *s == '/' )
+        {
+            file = 0;
+            if( --rank < 0 )
+                return( 0 );
+        }
+        else if( isdigit((unsigned char)*s) )
+            file += *s - '0';
+        else if( strchr("KQRBNPkqrbnp",*s) && file<8 )
+            r->square[rank*8 + file++] = *s;
+        else
+            return( 0 );
+    }
+    while( *s == ' ' )
+        s++;
+    r->white = (*s != 'b');
+    r->number = 1;
+    n = *s ? sscanf( s, "%*s %*s %*s %d %d", &quiet, &number ) : 0;
+    if( n >= 1 && quiet >= 0 )      // halfmove clock, for the fifty
+        r->quiet = quiet;           //  move rule (not in EPD)
+    if( n == 2 && number >= 1 )
+        r->number = number;
+    return( 1 );
+}
+
+// Is the piece on "at" white's ?
+static int white_piece( const referee *r, int at )
+{
+    return( isupper((unsigned char)r->square[at]) != 0 );
+}
+
+// Could the piece on "from" take on "to", empty squares between ?
+static int attacks( const referee *r, int from, int to )
+{
+    int df = to%8 - from%8, dr = to/8 - from/8;
+    int step, at;
+    char piece = toupper( (unsigned char)r->square[from] );
+
+    if( from == to )
+        return( 0 );
+    switch( piece )
+    {
+        case 'P':   return( abs(df)==1 && dr==(white_piece(r,from)?1:-1) );
+        case 'N':   return( abs(df*dr) == 2 );
+        case 'K':   return( abs(df)<=1 && abs(dr)<=1 );
+        case 'B':   if( abs(df) != abs(dr) ) return( 0 );
+                    break;
+        case 'R':   if( df && dr ) return( 0 );
+                    break;
+        case 'Q':   if( df && dr && abs(df)!=abs(dr) ) return( 0 );
+                    break;
+        default:    return( 0 );
+    }
+    step = (dr>0 ? 8 : dr<0 ? -8 : 0) + (df>0 ? 1 : df<0 ? -1 : 0);
+    for( at=from+step; at!=to; at+=step )
+    {
+        if( r->square[at] )
+            return( 0 );
+    }
+    return( 1 );
+}
+
+// Is square "at" attacked by white (or black) ?
+static int attacked( const referee *r, int at, int by_white )
+{
+    int from;
+    for( from=0; from<64; from++ )
+    {
+        if( r->square[from] && white_piece(r,from)==by_white &&
+                                                attacks(r,from,at) )
+            return( 1 );
+    }
+    return( 0 );
+}
+
+// Is white's (or black's) king in check ? No king counts as in check
+static int in_check( const referee *r, int white )
+{
+    char king = white ? 'K' : 'k';
+    int at;
+    for( at=0; at<64 && r->square[at]!=king; at++ )
+        ;
+    return( at == 64 || attacked( r, at, !white ) );
+}
+
+// Can the side to move play from "from" to "to", by the rules (without
+//  castling, en passant or promotion) ?
+static int legal( const referee *r, int from, int to )
+{
+    referee after;
+    int dr = to/8 - from/8, forward = r->white ? 1 : -1;
+
+    if( !r->square[from] || white_piece(r,from) != r->white ||
+        (r->square[to] && white_piece(r,to) == r->white) )
+        return( 0 );
+    if( toupper((unsigned char)r->square[from]) == 'P' )
+    {
+        if( r->square[to] )
+        {
+            if( !attacks( r, from, to ) )
+                return( 0 );
+        }
+        else if( to%8 != from%8 || (dr != forward &&
+                 (dr != 2*forward || from/8 != (r->white?1:6) ||
+                  r->square[from+8*forward])) )
+            return( 0 );
+    }
+    else if( !attacks( r, from, to ) )
+        return( 0 );
+    after = *r;
+    after.square[to]   = after.square[from];
+    after.square[from] = 0;
+    return( !in_check( &after, r->white ) );
+}
+
+// Has the side to move any move ?
+static int can_move( const referee *r )
+{
+    int from, to;
+    for( from=0; from<64; from++ )
+    {
+        for( to=0; to<64; to++ )
+        {
+            if( legal( r, from, to ) )
+                return( 1 );
+        }
+    }
+    return( 0 );
+}
+
+// Move in SAN, before it is made, eg "Nbd2", "exd5", "e8=Q"
+static void san( const referee *r, int from, int to, char *text )
+{
+    char piece = toupper( (unsigned char)r->square[from] );
+    int other, file=0, rank=0, ambiguous=0;
+
+    if( piece == 'P' )
+    {
+        if( r->square[to] )
+            text += sprintf( text, "%cx", 'a'+from%8 );
+        text += sprintf( text, "%c%c", 'a'+to%8, '1'+to/8 );
+        if( to/8 == 0 || to/8 == 7 )
+            strcpy( text, "=Q" );
+        return;
+    }
+    for( other=0; other<64; other++ )
+    {
+        if( other!=from && r->square[other]==r->square[from] &&
+                                            legal(r,other,to) )
+        {
+            ambiguous = 1;
+            file |= (other%8 == from%8);
+            rank |= (other/8 == from/8);
+        }
+    }
+    *text++ = piece;
+    if( ambiguous && (!file || rank) )
+        *text++ = 'a' + from%8;
+    if( ambiguous && file )
+        *text++ = '1' + from/8;
+    sprintf( text, "%s%c%c", r->square[to] ? "x" : "", 'a'+to%8, '1'+to/8 );
+}
+
+// Add to the game's move text
+static void append( game *g, const char *text )
+{
+    size_t len = g->moves ? strlen(g->moves) : 0;
+    g->moves = (char *)realloc( g->moves, len+strlen(text)+1 );
+    if( g->moves == NULL )
+    {
+        fprintf( stderr, "Out of memory\n" );
+        exit( 1 );
+    }
+    strcpy( g->moves+len, text );
+}
+
+// End of the game, "winner" 1 white, 0 black, -1 a draw, -2 abandoned
+static void finish( game *g, int winner, const char *reason )
+{
+    g->result = winner>0 ? "1-0" : winner==0 ? "0-1" :
+                winner==-1 ? "1/2-1/2" : "*";
+    strncpy( g->reason, reason, sizeof(g->reason)-1 );
+}
+
+// Play one game, engines[c] for configuration c
+static void play( mc_engine *engines[2], game *g, int number )
+{
+    referee r, seen[MAX_PLIES+1];
+    mc_engine *mc, *other;
+    mc_move best;
+    double start, left[2], took;
+    char text[5], move[32], label[16];
+    int side, c, i, repeats, from, to, mover, pawn, capture;
+    unsigned char f, t, squares[MC_PIECES];
+
+    // Set up, each engine playing its colour. The original canned opening
+    //  is switched off (by mc_set_position()), as it castles by moving
+    //  the king alone; a book file (book=) still works
+    referee_fen( &r, g->fen ? g->fen :
+            "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w - - 0 1" );
+    for( c=0; c<2; c++ )
+    {
+        side = (c == g->white);         // 1 if it plays white
+        mc = engines[c];
+        if( g->fen == NULL )
+            mc_new_game( mc, side );
+        else
+        {
+            if( MC_OK != mc_set_fen( mc, g->fen ) )
+            {
+                finish( g, -2, "position not set up" );
+                return;
+            }
+            if( side != r.white )
+                mc_reverse( mc );
+        }
+        mc_set_position( mc, squares, mc_get_position(mc,squares) );
+        mc_clear_hash( mc );
+        mc_seed_book( mc, (unsigned long)number );
+        left[c] = configs[c].time;
+        mc_set_clock( mc, configs[c].time<0 ? MC_CLOCK_OFF : left[c],
+                                            configs[c].increment, 0 );
+    }
+    if( !r.white )
+    {
+        sprintf( move, "%d... ", r.number );
+        append( g, move );
+    }
+
+    start = seconds();
+    for( g->plies=0; ; g->plies++ )
+    {
+        seen[g->plies] = r;
+        c = r.white ? g->white : 1-g->white;    // configuration to move
+        mc = engines[c];
+        other = engines[1-c];
+
+        // Adjudication
+        for( i=repeats=0; i<g->plies; i++ )
+        {
+            if( 0==memcmp(seen[i].square,r.square,64) &&
+                                            seen[i].white==r.white )
+                repeats++;
+        }
+        if( repeats >= 2 )
+        {
+            finish( g, -1, "threefold repetition" );
+            break;
+        }
+        if( r.quiet >= 100 )
+        {
+            finish( g, -1, "fifty move rule" );
+            break;
+        }
+        for( i=0; i<64 && (!r.square[i] || toupper(r.square[i])=='K'); i++ )
+            ;
+        if( i == 64 )
+        {
+            finish( g, -1, "bare kings" );
+            break;
+        }
+        if( g->plies >= 2*max_moves || g->plies >= MAX_PLIES )
+        {
+            finish( g, -1, "move limit" );
+            break;
+        }
+
+        // The engine to move chooses
+        took = seconds();
+        i = mc_go( mc, &best );
+        took = seconds() - took;
+        g->think[c] += took;
+        if( configs[c].time >= 0 )
+        {
+            left[c] -= took;
+            if( left[c] < 0 )
+            {
+                finish( g, !r.white, "time forfeit" );
+                break;
+            }
+            left[c] += configs[c].increment;
+        }
+        if( i != MC_OK )
+        {
+            if( can_move( &r ) )
+                finish( g, !r.white, "resigns" );
+            else if( in_check( &r, r.white ) )
+                finish( g, !r.white, "checkmate" );
+            else
+                finish( g, -1, "stalemate" );
+            break;
+        }
+
+        // Check it, make it on the referee's board and the other engine's
+        mc_move_text( mc, &best, text );
+        from = (text[1]-'1')*8 + text[0]-'a';
+        to   = (text[3]-'1')*8 + text[2]-'a';
+        if( !legal( &r, from, to ) )
+        {
+            sprintf( move, "illegal move %s", text );
+            finish( g, !r.white, move );
+            break;
+        }
+        mover = r.white;
+        pawn  = toupper( (unsigned char)r.square[from] ) == 'P';
+        capture = r.square[to] != 0;
+        san( &r, from, to, move );
+        r.square[to]   = r.square[from];
+        r.square[from] = 0;
+        r.white = !r.white;
+        r.quiet = (pawn || capture) ? 0 : r.quiet+1;
+        if( mover )
+        {
+            sprintf( label, "%d. ", r.number );
+            append( g, label );
+        }
+        else
+            r.number++;
+        if( in_check( &r, r.white ) )
+            strcat( move, can_move(&r) ? "+" : "#" );
+        strcat( move, " " );
+        append( g, move );
+        if( pawn && (to/8 == 0 || to/8 == 7) )
+        {
+            g->plies++;
+            finish( g, mover, "promotion" );
+            break;
+        }
+        if( MC_OK != mc_parse_move( other, text, &f, &t ) ||
+            MC_OK != mc_apply_move( other, f, t ) )
+        {
+            g->plies++;
+            finish( g, -1, "engine error" );
+            break;
+        }
+    }
+    g->seconds = seconds() - start;
+}
+
+// One thread of the pool, an engine for each configuration, games first
+//  come first served
+static void *worker( void *arg )
+{
+    mc_engine *engines[2];
+    int i;
+
+    (void)arg;
+    engines[0] = engine( &configs[0] );
+    engines[1] = engine( &configs[1] );
+    if( engines[0] == NULL || engines[1] == NULL )
+    {
+        fprintf( stderr, "Can't create engine\n" );
+        exit( 1 );
+    }
+    for(;;)
+    {
+        pthread_mutex_lock( &lock );
+        i = next++;
+        pthread_mutex_unlock( &lock );
+        if( i >= ngames )
+            break;
+        play( engines, &games[i], i );
+    }
+    mc_destroy( engines[0] );
+    mc_destroy( engines[1] );
+    return( NULL );
+}
+
+// Read the openings, one FEN or EPD position per non blank line. Those
+//  microchess can't set up (eg with a second queen) are skipped
+static int load( const char *path )
+{
+    FILE *f = fopen( path, "r" );
+    char line[MAX_LINE];
+    referee r;
+    mc_engine *mc;
+    char **more;
+    int size = 0, number = 0;
+    size_t len;
+
+    if( f == NULL )
+    {
+        fprintf( stderr, "Can't open %s\n", path );
+        return( 0 );
+    }
+    mc = mc_create();
+    if( mc == NULL )
+    {
+        fprintf( stderr, "Can't create engine\n" );
+        fclose( f );
+        return( 0 );
+    }
+    while( fgets(line,sizeof(line),f) )
+    {
+        number++;
+        len = strlen( line );
+        while( len && isspace((unsigned char)line[len-1]) )
+            line[--len] = '\0';
+        if( len==0 || line[0]=='#' )
+            continue;
+        if( !referee_fen( &r, line ) )
+        {
+            fprintf( stderr, "Bad position in %s: %s\n", path, line );
+            fclose( f );
+            mc_destroy( mc );
+            return( 0 );
+        }
+        if( MC_OK != mc_set_fen( mc, line ) )
+        {
+            fprintf( stderr, "%s:%d: microchess can't set up %s, skipped\n",
+                                                        path, number, line );
+            continue;
+        }
+        if( nopenings == size )
+        {
+            more = (char **)realloc( openings,
+                                    (size ? size*2 : 64)*sizeof(char *) );
+            if( more == NULL )
+            {
+                fprintf( stderr, "Out of memory\n" );
+                fclose( f );
+                mc_destroy( mc );
+                return( 0 );
+            }
+            openings = more;
+            size = size ? size*2 : 64;
+        }
+        openings[nopenings] = strdup( line );
+        if( openings[nopenings] == NULL )
+        {
+            fprintf( stderr, "Out of memory\n" );
+            fclose( f );
+            mc_destroy( mc );
+            return( 0 );
+        }
+        nopenings++;
+    }
+    fclose( f );
+    mc_destroy( mc );
+    if( nopenings == 0 )
+        fprintf( stderr, "No positions in %s\n", path );
+    return( nopenings > 0 );
+}
+
+// Move text and the end of the game, in lines of at most 79 characters
+//  (a comment is never split)
+static void wrap( FILE *f, const char *moves, const char *end )
+{
+    const char *s = moves, *word;
+    int column = 0;
+    size_t len;
+
+    for(;;)
+    {
+        while( *s == ' ' )
+            s++;
+        if( *s == '\0' )
+        {
+            s = end;
+            end = NULL;
+            if( s == NULL )
+                break;
+        }
+        word = s;
+        len = (*s=='{' && strchr(s,'}')) ? (size_t)(strchr(s,'}')+1-s)
+                                         : strcspn( s, " " );
+        if( column && column+1+len > 79 )
+        {
+            fputc( '\n', f );
+            column = 0;
+        }
+        else if( column )
+        {
+            fputc( ' ', f );
+            column++;
+        }
+        fwrite( word, 1, len, f );
+        column += (int)len;
+        s = word + len;
+    }
+    fprintf( f, "\n\n" );
+}
+
+// Write the games as PGN
+static int save( const char *path )
+{
+    FILE *f = fopen( path, "w" );
+    char date[16], end[128];
+    time_t now = time( NULL );
+    int i;
+
+    if( f == NULL )
+    {
+        fprintf( stderr, "Can't create %s\n", path );
+        return( 0 );
+    }
+    strftime( date, sizeof(date), "%Y.%m.%d", localtime(&now) );
+    for( i=0; i<ngames; i++ )
+    {
+        game *g = &games[i];
+        fprintf( f, "[Event \"MicroChess match\"]\n" );
+        fprintf( f, "[Site \"?\"]\n" );
+        fprintf( f, "[Date \"%s\"]\n", date );
+        fprintf( f, "[Round \"%d\"]\n", i+1 );
+        fprintf( f, "[White \"%s\"]\n", configs[g->white].name );
+        fprintf( f, "[Black \"%s\"]\n", configs[1-g->white].name );
+        fprintf( f, "[Result \"%s\"]\n", g->result );
+        if( g->fen )
+            fprintf( f, "[SetUp \"1\"]\n[FEN \"%s\"]\n", g->fen );
+        fprintf( f, "[PlyCount \"%d\"]\n", g->plies );
+        fprintf( f, "[Termination \"%s\"]\n\n", g->reason );
+        sprintf( end, "{%s, %.2fs} %s", g->reason, g->seconds, g->result );
+        wrap( f, g->moves ? g->moves : "", end );
+    }
+    i = ferror( f );
+    if( fclose(f) != 0 || i )
+    {
+        fprintf( stderr, "Can't write %s\n", path );
+        return( 0 );
+    }
+    return( 1 );
+}
+
+static int usage( void )
+{
+    fprintf( stderr, "Usage: microchess-match [-n games] [-j jobs]"
+                     " [-m max_moves]\n"
+                     "          [-f openings] [-o pgn_file]"
+                     " config1 config2\n"
+                     "config: name=,level=1|2|3,gen=6502|bitboard,"
+                     "native=native|6502,\n"
+                     "        prune=pruned|full,hash=mb,book=file,"
+                     "time=seconds[+increment]\n" );
+    return( 1 );
+}
+
+int main( int argc, char* argv[] )
+{
+    pthread_t threads[MAX_JOBS];
+    int i, jobs, started, nconfigs=0, wins=0, draws=0, losses=0, scored;
+    const char *path=NULL, *pgn="match.pgn";
+    double start, elapsed, score;
+
+    jobs = (int)sysconf( _SC_NPROCESSORS_ONLN );
+
+    // Options
+    for( i=1; i<argc; i++ )
+    {
+        if( 0==strcmp(argv[i],"-n") && i+1<argc )
+            ngames = atoi( argv[++i] );
+        else if( 0==strcmp(argv[i],"-j") && i+1<argc )
+            jobs = atoi( argv[++i] );
+        else if( 0==strcmp(argv[i],"-m") && i+1<argc )
+            max_moves = atoi( argv[++i] );
+        else if( 0==strcmp(argv[i],"-f") && i+1<argc )
+            path = argv[++i];
+        else if( 0==strcmp(argv[i],"-o") && i+1<argc )
+            pgn = argv[++i];
+        else if( argv[i][0] != '-' && nconfigs < 2 )
+        {
+            if( !configure( &configs[nconfigs++], argv[i] ) )
+            {
+                fprintf( stderr, "Bad configuration %s\n", argv[i] );
+                return( usage() );
+            }
+        }
+        else
+            return( usage() );
+    }
+    if( nconfigs != 2 || ngames < 1 || max_moves < 1 )
+        return( usage() );
+    if( jobs < 1 )
+        jobs = 1;
+    if( jobs > MAX_JOBS )
+        jobs = MAX_JOBS;
+    if( path && !load(path) )
+        return( 1 );
+    if( ngames > 2 && nopenings == 0 && !configs[0].book[0]
+                                     && !configs[1].book[0] )
+    {
+        fprintf( stderr, "Without openings (-f) or a book (book=) every"
+                         " pair of games is the same, play at most 2\n" );
+        return( 1 );
+    }
+    games = (game *)calloc( ngames, sizeof(game) );
+    if( games == NULL )
+    {
+        fprintf( stderr, "Out of memory\n" );
+        return( 1 );
+    }
+
+    // Each opening twice, the colours swapped
+    for( i=0; i<ngames; i++ )
+    {
+        games[i].fen   = nopenings ? openings[(i/2)%nopenings] : NULL;
+        games[i].white = i%2;
+    }
+
+    // Play them all
+    start = seconds();
+    for( started=0; started<jobs && started<ngames; started++ )
+    {
+        if( 0 != pthread_create( &threads[started], NULL, worker, NULL ) )
+            break;
+    }
+    if( started == 0 )
+        worker( NULL );
+    for( i=0; i<started; i++ )
+        pthread_join( threads[i], NULL );
+    elapsed = seconds() - start;
+
+    // Results, in the order of the games
+    printf( "game,white,black,result,termination,plies,seconds,"
+                                        "white_seconds,black_seconds\n" );
+    for( i=0; i<ngames; i++ )
+    {
+        game *g = &games[i];
+        printf( "%d,\"%s\",\"%s\",%s,%s,%d,%.3f,%.3f,%.3f\n", i+1,
+                configs[g->white].name, configs[1-g->white].name,
+                g->result, g->reason, g->plies, g->seconds,
+                g->think[g->white], g->think[1-g->white] );
+        if( g->result[0] == '*' )
+            continue;
+        if( g->result[1] == '/' )
+            draws++;
+        else if( (g->result[0]=='1') == (g->white==0) )
+            wins++;
+        else
+            losses++;
+    }
+    scored = wins + draws + losses;
+    score = scored ? (wins + draws/2.0) / scored : 0;
+    fprintf( stderr, "%d games on %d threads in %.3fs, %s scored"
+                     " +%d =%d -%d (%.1f%%)", ngames, started ? started : 1,
+                     elapsed, configs[0].name, wins, draws, losses,
+                     100.0*score );
+    if( score > 0 && score < 1 )
+        fprintf( stderr, ", %+.0f Elo",
+                        0.0 - 400.0*log10( 1.0/score - 1.0 ) );
+    if( scored < ngames )
+        fprintf( stderr, ", %d abandoned", ngames-scored );
+    fprintf( stderr, "\n" );
+    i = save( pgn );
+    for( started=0; started<ngames; started++ )
+        free( games[started].moves );
+    free( games );
+    for( started=0; started<nopenings; started++ )
+        free( openings[started] );
+    free( openings );
+    return( i ? 0 : 1 );
+}
@@ -45,53 +45,180 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <ctype.h>
-#include <setjmp.h>
 #include <math.h>
+#include <time.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "microchess.h"
+
+// 6502 emulation memory and registers, plus the handful of microchess
+//  settings the Kim-1 kept in fixed locations, are gathered into one
+//  engine context. Every routine receives the context as "mc" so that
+//  any number of independent games can run in one process (and on as
+//  many threads as we like, one engine per thread)
+typedef unsigned char byte;
+typedef struct split split;
+typedef struct pool pool;
+typedef struct gen_list gen_list;
+typedef struct perft perft;
+typedef struct hash_table hash_table;
+typedef struct book_file book_file;
+struct mc_engine
+{
+    // 6502 emulation memory
+    byte zeropage[256];
+    byte stack[256];
+    byte stack_cy[256];
+    byte stack_v[256];
+
+    // 6502 emulation registers
+    byte reg_a, reg_f, reg_x, reg_y, reg_s, reg_cy, reg_v, temp_cy;
+    unsigned int temp1, temp2;
+
+    // Outcome of the current command, see RESTART_CHESS()
+    int status;
+
+    // Square to piece mailbox, see mailbox_build() in Part 2
+    byte mailbox[128];
+    byte mailbox_sq, mailbox_pc;
+
+    // Search depth settings (see level information in Part 2), the
+    //  level they make and the level mc_set_level() asked for
+    byte level1;
+    byte level2;
+    int level;
+    int fixed_level;
+
+    // Time control, see Part 16. With the clock on mc_go() chooses the
+    //  level from the JANUS calls per GO and per second measured at each
+    //  level (index 1 to 3) by earlier searches
+    int clock_on;
+    double clock_remaining, clock_increment;
+    int clock_moves;
+    double clock_nodes[4], clock_rate[4];
+
+    // Value of the move GO last chose by search, before MV2 reuses
+    //  BESTV to display the from square (0 for an opening book move)
+    byte score;
+
+    // Set while mc_console() drives the engine, otherwise the engine is
+    //  embedded and prints nothing
+    int bool_console;
+
+    // Parallel root search, see Part 6. GO splits the root moves over
+    //  "threads" workers; a worker has "work" set, is numbered "id" and
+    //  counts the root moves it sees in "root". The worker threads are
+    //  started by the first parallel GO and kept in "pool" until the
+    //  number of threads changes or the engine is destroyed
+    int threads;
+    pool *pool;
+    split *work;
+    int id;
+    int root;
+
+    // Move generator, see Part 8. While "record" is set JANUS only lists
+    //  the moves it is offered
+    int generator;
+    gen_list *record;
+    long mismatches;
+
+    // Native fast path, see Part 15. Comparing, JANUS works out in
+    //  native_zp (native_counted set) what its counts should come to
+    int native;
+    long native_mismatches;
+    byte native_zp[256];
+    int native_counted;
+
+    // Capture tree pruning, see Part 17
+    int pruning;
+    long pruning_mismatches;
+
+    // Opening book file, see Part 18, mapped once and shared by every
+    //  engine using it. book_random chooses between its weighted moves
+    book_file *book;
+    unsigned long long book_random;
+
+    // Set while mc_perft() counts positions, see Part 9
+    perft *perft;
+
+    // Search counters for the last GO, see Part 11
+    mc_stats stats;
+
+    // Zobrist keys of the position and of the same position reversed,
+    //  kept up to date by MOVE, UMOVE and REVERSE, and the transposition
+    //  table (shared with any parallel search workers), see Part 13
+    unsigned long long key, rkey;
+    hash_table *hash;
+
+    // Console output, buffered until the next command is read, and how
+    //  many characters of it are still to be dropped, see Part 4
+    char *out;
+    int out_len;
+    int discard;
+    int board_length;
+    int bool_hint;
+
+    // Console input line, and the offset of the next character of it to
+    //  hand COMMAND (0 once it has all been handed over), see smart_in()
+    char in[MC_FEN_MAX+8];
+    int in_offset;
+    int bool_auto;
+
+    // WRF debug stuff
+    int bool_show_move_evaluation;
+    int bool_show_move_generation;
+};
+
+// Search counters (Part 11), compiled out with MC_NO_STATS
+#ifdef MC_NO_STATS
+#define STAT(counter)
+#else
+#define STAT(counter)   (mc->stats.counter++)
+#endif
 
-// Use <setjmp.h> macros and functions to emulate the "jump to reset
-//  stack pointer then restart program" behaviour used by microchess
-jmp_buf jmp_chess;
-#define EXIT        -1
-#define RESTART     -2
-void RESTART_CHESS( void )  // start CHESS program with reset stack
+// Microchess finishes every command by jumping to "reset stack pointer
+//  then restart program". Rather than a non-local jump we record the
+//  outcome in mc->status; each command is a tail call (JMP) chain so the
+//  routines simply return to whoever issued the command, which then
+//  restarts CHESS (or not) as it sees fit
+#define RUNNING     (-1)
+#define RESTART     MC_OK
+#define EXIT        MC_EXIT
+void RESTART_CHESS( mc_engine *mc )  // start CHESS program with reset stack
 {
-    longjmp( jmp_chess, RESTART );
+    mc->status = RESTART;
 }
-void EXIT_TO_SYSTEM( void ) // return to operating system
+void EXIT_TO_SYSTEM( mc_engine *mc ) // return to operating system
 {
-    longjmp( jmp_chess, EXIT );
+    mc->status = EXIT;
 }
 
-// 6502 emulation memory
-typedef unsigned char byte;
-byte zeropage[256];
-byte stack[256];
-byte stack_cy[256];
-byte stack_v[256];
-
-// 6502 emulation registers
-byte reg_a, reg_f, reg_x, reg_y, reg_s, reg_cy, reg_v, temp_cy;
-unsigned int temp1, temp2;
-
 // Debug stuff
 #if 0
-    #define DBG , register_dump()
+    #define DBG , register_dump( mc )
 #else
     #define DBG
 #endif
-void register_dump( void )
+void register_dump( mc_engine *mc )
 {
     printf( "A=%02x X=%02x Y=%02x S=%02x F=%02X CY=%d V=%d\n",
-        reg_a, reg_x, reg_y, reg_s, reg_f, reg_cy, reg_v );
+        mc->reg_a, mc->reg_x, mc->reg_y, mc->reg_s,
+        mc->reg_f, mc->reg_cy, mc->reg_v );
 }
 
 // 6502 emulation macros - register moves
-#define T(src,dst)          reg_f = (dst) = (src)    DBG
-#define A reg_a
-#define S reg_s
-#define X reg_x
-#define Y reg_y
+#define T(src,dst)          mc->reg_f = (dst) = (src)                     DBG
+#define A mc->reg_a
+#define S mc->reg_s
+#define X mc->reg_x
+#define Y mc->reg_y
 #define TYA                 T(Y,A)
 #define TXS                 T(X,S)
 #define TAX                 T(A,X)
@@ -99,19 +226,22 @@ void register_dump( void )
 #define TSX                 T(S,X)
 #define TXA                 T(X,A)
 
-// 6502 emulation macros - branches
-#define BEQ(label)          if( reg_f == 0 )     goto label
-#define BNE(label)          if( reg_f != 0 )     goto label
-#define BPL(label)          if( ! (reg_f&0x80) ) goto label
-#define BMI(label)          if( reg_f & 0x80 )   goto label
-#define BCC(label)          if( !reg_cy )        goto label
-#define BCS(label)          if( reg_cy )         goto label
-#define BVC(label)          if( !reg_v )         goto label
-#define BVS(label)          if( reg_v )          goto label
+// 6502 emulation macros - branches. N and Z are read from the last
+//  result (reg_f) when a branch needs them; C is worked out at once by
+//  ADC, SBC, CMP and the shifts, as on the 6502. (Deferring C until it
+//  is read was tried, it measured no faster)
+#define BEQ(label)          if( mc->reg_f == 0 )       goto label
+#define BNE(label)          if( mc->reg_f != 0 )       goto label
+#define BPL(label)          if( ! (mc->reg_f&0x80) )   goto label
+#define BMI(label)          if( mc->reg_f & 0x80 )     goto label
+#define BCC(label)          if( !mc->reg_cy )          goto label
+#define BCS(label)          if( mc->reg_cy )           goto label
+#define BVC(label)          if( !mc->reg_v )           goto label
+#define BVS(label)          if( mc->reg_v )            goto label
 #define BRA(label) /*extra*/ goto label
 
 // 6502 emulation macros - call/return from functions
-#define JSR(func)           func()
+#define JSR(func)           func( mc )
 #define RTS                 return
 
 // 6502 emulation macros - jump to functions, note that in
@@ -120,9 +250,9 @@ void register_dump( void )
 //  that in the high level language by (actually) calling then
 //  returning. There is no JEQ 6502 opcode, but it's useful to
 //  us so we have made it up! (like BRA, SEV)
-#define JMP(func)           if( 1 )          { func(); return; } \
+#define JMP(func)           if( 1 )              { func( mc ); return; } \
                             else // else eats ';'
-#define JEQ(func) /*extra*/ if( reg_f == 0 ) { func(); return; } \
+#define JEQ(func) /*extra*/ if( mc->reg_f == 0 ) { func( mc ); return; } \
                             else // else eats ';'
 
 // 6502 emulation macros - load registers
@@ -131,90 +261,99 @@ void register_dump( void )
 //   i = immediate
 //   x = indexed, zero page
 //   f = indexed, not zero page (f for "far")
-#define ZP(addr8)           (zeropage[ (byte) (addr8) ])
-#define ZPX(addr8,idx)      (zeropage[ (byte) ((addr8)+(idx)) ])
-#define LDAi(dat8)          reg_f = reg_a = dat8                  DBG
-#define LDAx(addr8,idx)     reg_f = reg_a = ZPX(addr8,idx)        DBG
-#define LDAf(addr16,idx)    reg_f = reg_a = (addr16)[idx]         DBG
-#define LDA(addr8)          reg_f = reg_a = ZP(addr8)             DBG
-#define LDXi(dat8)          reg_f = reg_x = dat8                  DBG
-#define LDX(addr8)          reg_f = reg_x = ZP(addr8)             DBG
-#define LDYi(dat8)          reg_f = reg_y = dat8                  DBG
-#define LDY(addr8)          reg_f = reg_y = ZP(addr8)             DBG
-#define LDYx(addr8,idx)     reg_f = reg_y = ZPX(addr8,idx)        DBG
+#define ZP(addr8)           (mc->zeropage[ (byte) (addr8) ])
+#define ZPX(addr8,idx)      (mc->zeropage[ (byte) ((addr8)+(idx)) ])
+#define LDAi(dat8)          mc->reg_f = mc->reg_a = dat8                  DBG
+#define LDAx(addr8,idx)     mc->reg_f = mc->reg_a = ZPX(addr8,idx)        DBG
+#define LDAf(addr16,idx)    mc->reg_f = mc->reg_a = (addr16)[idx]         DBG
+#define LDA(addr8)          mc->reg_f = mc->reg_a = ZP(addr8)             DBG
+#define LDXi(dat8)          mc->reg_f = mc->reg_x = dat8                  DBG
+#define LDX(addr8)          mc->reg_f = mc->reg_x = ZP(addr8)             DBG
+#define LDYi(dat8)          mc->reg_f = mc->reg_y = dat8                  DBG
+#define LDY(addr8)          mc->reg_f = mc->reg_y = ZP(addr8)             DBG
+#define LDYx(addr8,idx)     mc->reg_f = mc->reg_y = ZPX(addr8,idx)        DBG
 
 // 6502 emulation macros - store registers
-#define STA(addr8)          ZP(addr8)      = reg_a                DBG
-#define STAx(addr8,idx)     ZPX(addr8,idx) = reg_a                DBG
-#define STX(addr8)          ZP(addr8)      = reg_x                DBG
-#define STY(addr8)          ZP(addr8)      = reg_y                DBG
-#define STYx(addr8,idx)     ZPX(addr8,idx) = reg_y                DBG
+#define STA(addr8)          ZP(addr8)      = mc->reg_a                    DBG
+#define STAx(addr8,idx)     ZPX(addr8,idx) = mc->reg_a                    DBG
+#define STX(addr8)          ZP(addr8)      = mc->reg_x                    DBG
+#define STY(addr8)          ZP(addr8)      = mc->reg_y                    DBG
+#define STYx(addr8,idx)     ZPX(addr8,idx) = mc->reg_y                    DBG
 
 // 6502 emulation macros - set/clear flags
 #define CLD            // luckily CPU's BCD flag is cleared then never set
-#define CLC                 reg_cy = 0                            DBG
-#define SEC                 reg_cy = 1                            DBG
-#define CLV                 reg_v  = 0                            DBG
-#define SEV /*extra*/       reg_v  = 1  /*avoid problematic V emulation*/ DBG
+#define CLC                 mc->reg_cy = 0                                DBG
+#define SEC                 mc->reg_cy = 1                                DBG
+#define CLV                 mc->reg_v  = 0                                DBG
+#define SEV /*extra*/       mc->reg_v  = 1  /*avoid problematic V emulation*/ DBG
 
 // 6502 emulation macros - accumulator logical operations
-#define ANDi(dat8)          reg_f = (reg_a &= dat8)               DBG
-#define ORA(addr8)          reg_f = (reg_a |= ZP(addr8))          DBG
+#define ANDi(dat8)          mc->reg_f = (mc->reg_a &= dat8)               DBG
+#define ORA(addr8)          mc->reg_f = (mc->reg_a |= ZP(addr8))          DBG
 
 // 6502 emulation macros - shifts and rotates
-#define ASL(addr8)          reg_cy = (ZP(addr8)&0x80) ? 1 : 0,  \
-                            ZP(addr8) = ZP(addr8)<<1,           \
-                            reg_f = ZP(addr8)                     DBG
-#define ROL(addr8)          temp_cy = (ZP(addr8)&0x80) ? 1 : 0, \
-                            ZP(addr8) = ZP(addr8)<<1,           \
-                            ZP(addr8) |= reg_cy,                \
-                            reg_cy = temp_cy,                   \
-                            reg_f = ZP(addr8)                     DBG
-#define LSR                 reg_cy = reg_a & 0x01,              \
-                            reg_a  = reg_a>>1,                  \
-                            reg_a  &= 0x7f,                     \
-                            reg_f = reg_a                         DBG
+#define ASL(addr8)          mc->reg_cy = (ZP(addr8)&0x80) ? 1 : 0,        \
+                            ZP(addr8) = ZP(addr8)<<1,                     \
+                            mc->reg_f = ZP(addr8)                         DBG
+#define ROL(addr8)          mc->temp_cy = (ZP(addr8)&0x80) ? 1 : 0,       \
+                            ZP(addr8) = ZP(addr8)<<1,                     \
+                            ZP(addr8) |= mc->reg_cy,                      \
+                            mc->reg_cy = mc->temp_cy,                     \
+                            mc->reg_f = ZP(addr8)                         DBG
+#define LSR                 mc->reg_cy = mc->reg_a & 0x01,                \
+                            mc->reg_a  = mc->reg_a>>1,                    \
+                            mc->reg_a  &= 0x7f,                           \
+                            mc->reg_f = mc->reg_a                         DBG
 
 // 6502 emulation macros - push and pull
-#define PHA                 stack[reg_s--]  = reg_a               DBG
-#define PLA                 reg_a           = stack[++reg_s]      DBG
-#define PHY                 stack[reg_s--]  = reg_y               DBG
-#define PLY                 reg_y           = stack[++reg_s]      DBG
-#define PHP                 stack   [reg_s] = reg_f,       \
-                            stack_cy[reg_s] = reg_cy,      \
-                            stack_v [reg_s] = reg_v,       \
-                            reg_s--                               DBG
-#define PLP                 reg_s++,                       \
-                            reg_f  = stack   [reg_s],      \
-                            reg_cy = stack_cy[reg_s],      \
-                            reg_v  = stack_v [reg_s]              DBG
+#define PHA                 mc->stack[mc->reg_s--]  = mc->reg_a                DBG
+#define PLA                 mc->reg_a               = mc->stack[++mc->reg_s] DBG
+#define PHY                 mc->stack[mc->reg_s--]  = mc->reg_y                DBG
+#define PLY                 mc->reg_y               = mc->stack[++mc->reg_s] DBG
+#define PHP                 mc->stack   [mc->reg_s] = mc->reg_f,          \
+                            mc->stack_cy[mc->reg_s] = mc->reg_cy,         \
+                            mc->stack_v [mc->reg_s] = mc->reg_v,          \
+                            mc->reg_s--                                   DBG
+#define PLP                 mc->reg_s++,                                  \
+                            mc->reg_f  = mc->stack   [mc->reg_s],         \
+                            mc->reg_cy = mc->stack_cy[mc->reg_s],         \
+                            mc->reg_v  = mc->stack_v [mc->reg_s]          DBG
 
 // 6502 emulation macros - compare
-#define cmp(reg,dat)        reg_f  = ((reg) - (dat)), \
-                            reg_cy = ((reg) >= (dat) ? 1 : 0)  DBG
-#define CMPi(dat8)          cmp( reg_a, dat8 )
-#define CMP(addr8)          cmp( reg_a, ZP(addr8) )
-#define CMPx(addr8,idx)     cmp( reg_a, ZPX(addr8,idx) )
-#define CMPf(addr16,idx)    cmp( reg_a, (addr16)[idx] )
-#define CPXi(dat8)          cmp( reg_x, dat8 )
-#define CPXf(addr16,idx)    cmp( reg_x, (addr16)[idx] )
-#define CPYi(dat8)          cmp( reg_y, dat8 )
+#define cmp(reg,dat)        mc->reg_f  = ((reg) - (dat)),                 \
+                            mc->reg_cy = ((reg) >= (dat) ? 1 : 0)         DBG
+#define CMPi(dat8)          cmp( mc->reg_a, dat8 )
+#define CMP(addr8)          cmp( mc->reg_a, ZP(addr8) )
+#define CMPx(addr8,idx)     cmp( mc->reg_a, ZPX(addr8,idx) )
+#define CMPf(addr16,idx)    cmp( mc->reg_a, (addr16)[idx] )
+#define CPXi(dat8)          cmp( mc->reg_x, dat8 )
+#define CPXf(addr16,idx)    cmp( mc->reg_x, (addr16)[idx] )
+#define CPYi(dat8)          cmp( mc->reg_y, dat8 )
+
+// 6502 emulation macros - made up opcode, X = index of the piece on
+//  square A or 0xFF if empty; replaces microchess' 32 way searches of
+//  the piece list (see mailbox_find())
+#define LDXm /*extra*/      mc->reg_f = mc->reg_x = mailbox_find(mc,mc->reg_a) DBG
+
+// 6502 emulation macros - made up opcode, Y = index within BK of the
+//  opponent's piece on square A (replaces the searches of BK in JANUS)
+#define LDYm /*extra*/      mc->reg_f = mc->reg_y = mailbox_find(mc,mc->reg_a) - 0x10 DBG
 
 // 6502 emulation macros - increment,decrement
-#define DEX                 reg_f = --reg_x                       DBG
-#define DEY                 reg_f = --reg_y                       DBG
-#define DEC(addr8)          reg_f = --ZP(addr8)                   DBG
-#define INX                 reg_f = ++reg_x                       DBG
-#define INY                 reg_f = ++reg_y                       DBG
-#define INC(addr8)          reg_f = ++ZP(addr8)                   DBG
-#define INCx(addr8,idx)     reg_f = ++ZPX(addr8,idx)              DBG
+#define DEX                 mc->reg_f = --mc->reg_x                       DBG
+#define DEY                 mc->reg_f = --mc->reg_y                       DBG
+#define DEC(addr8)          mc->reg_f = --ZP(addr8)                       DBG
+#define INX                 mc->reg_f = ++mc->reg_x                       DBG
+#define INY                 mc->reg_f = ++mc->reg_y                       DBG
+#define INC(addr8)          mc->reg_f = ++ZP(addr8)                       DBG
+#define INCx(addr8,idx)     mc->reg_f = ++ZPX(addr8,idx)                  DBG
 
 // 6502 emulation macros - add
-#define adc(dat)            temp1 = reg_a,                   \
-                            temp2 = (dat),                   \
-                            temp1 += (temp2+(reg_cy?1:0)),   \
-                            reg_f = reg_a = (byte)temp1,     \
-                            reg_cy = ((temp1&0xff00)?1:0)         DBG
+#define adc(dat)            mc->temp1 = mc->reg_a,                        \
+                            mc->temp2 = (dat),                            \
+                            mc->temp1 += (mc->temp2+(mc->reg_cy?1:0)),    \
+                            mc->reg_f = mc->reg_a = (byte)mc->temp1,      \
+                            mc->reg_cy = ((mc->temp1&0xff00)?1:0)         DBG
 #define ADCi(dat8)          adc( dat8 )
 #define ADC(addr8)          adc( ZP(addr8) )
 #define ADCx(addr8,idx)     adc( ZPX(addr8,idx) )
@@ -223,16 +362,16 @@ void register_dump( void )
 // 6502 emulation macros - subtract
 //   (note that both as an input and an output cy flag has opposite
 //    sense to that used for adc(), seems unintuitive to me)
-#define sbc(dat)            temp1 = reg_a,                   \
-                            temp2 = (dat),                   \
-                            temp1 -= (temp2+(reg_cy?0:1)),   \
-                            reg_f = reg_a = (byte)temp1,     \
-                            reg_cy = ((temp1&0xff00)?0:1)         DBG
+#define sbc(dat)            mc->temp1 = mc->reg_a,                        \
+                            mc->temp2 = (dat),                            \
+                            mc->temp1 -= (mc->temp2+(mc->reg_cy?0:1)),    \
+                            mc->reg_f = mc->reg_a = (byte)mc->temp1,      \
+                            mc->reg_cy = ((mc->temp1&0xff00)?0:1)         DBG
 #define SBC(addr8)          sbc( ZP(addr8) )
 #define SBCx(addr8,idx)     sbc( ZPX(addr8,idx) )
 
 // Test some of the trickier opcodes (hook this up as needed)
-void test_function( void )
+void test_function( mc_engine *mc )
 {
     byte hi, lo;
                 LDAi    (0x33);     // 0x4444 - 0x3333 = 0x1111
@@ -241,10 +380,10 @@ void test_function( void )
                 LDAi    (0x44);
                 SEC;
                 SBC     (0);
-                lo      = reg_a;
+                lo      = mc->reg_a;
                 LDAi    (0x44);
                 SBC     (1);
-                hi      = reg_a;
+                hi      = mc->reg_a;
 
                 LDAi    (0x44);     // 0x3333 - 0x4444 = 0xeeef
                 STA     (0);
@@ -252,10 +391,10 @@ void test_function( void )
                 LDAi    (0x33);
                 SEC;
                 SBC     (0);
-                lo      = reg_a;
+                lo      = mc->reg_a;
                 LDAi    (0x33);
                 SBC     (1);
-                hi      = reg_a;
+                hi      = mc->reg_a;
 
                 LDAi    (0x33);     // 0x3333 + 0x4444 = 0x7777
                 STA     (0);
@@ -263,10 +402,10 @@ void test_function( void )
                 LDAi    (0x44);
                 CLC;
                 ADC     (0);
-                lo      = reg_a;
+                lo      = mc->reg_a;
                 LDAi    (0x44);
                 ADC     (1);
-                hi      = reg_a;
+                hi      = mc->reg_a;
 }
 
 
@@ -355,65 +494,188 @@ byte OPNING[] = {       0x99, 0x25, 0x0B, 0x25, 0x01, 0x00, 0x33, 0x25,
 //       | SUPER BLITZ |    00     |    FF
 //       | BLITZ       |    00     |    FB
 //       | NORMAL      |    08     |    FB
-static byte level1=8;
-static byte level2=0xfb;
+//       Each engine starts at NORMAL, see mc_create()
+
+// Square to piece mailbox, mailbox[square] is the index of the piece on
+//  that square or 0xFF if it is empty. REVERSE would need to mirror all
+//  64 squares, so instead the mailbox is kept in a fixed orientation and
+//  mailbox_sq (0 or 0x77, ie 0x77-square) and mailbox_pc (0 or 0x10, ie
+//  BOARD <-> BK) translate to and from the current one
+#define EMPTY       0xFF
+static byte mailbox_find( mc_engine *mc, byte square )
+{
+    byte piece;
+    if( square & 0x88 )
+        return( EMPTY );    // off board (eg 0xCC), never occupied
+    piece = mc->mailbox[ square ^ mc->mailbox_sq ];
+    return( piece==EMPTY ? EMPTY : piece ^ mc->mailbox_pc );
+}
+static void mailbox_put( mc_engine *mc, byte square, byte piece )
+{
+    if( square & 0x88 )
+        return;
+    mc->mailbox[ square ^ mc->mailbox_sq ] =
+                    piece==EMPTY ? EMPTY : piece ^ mc->mailbox_pc;
+}
+
+static void zobrist_build( mc_engine *mc );
+
+// Rebuild the mailbox from scratch, needed after any change to BOARD
+//  other than by MOVE, UMOVE and REVERSE. If two pieces claim a square
+//  the higher index wins, as it did with the old searches
+static void mailbox_build( mc_engine *mc )
+{
+    int i;
+    memset( mc->mailbox, EMPTY, sizeof(mc->mailbox) );
+    mc->mailbox_sq = mc->mailbox_pc = 0;
+    for( i=0; i<32; i++ )
+        mailbox_put( mc, ZP(BOARD+i), (byte)i );
+    zobrist_build( mc );    // (Part 13)
+}
 
 // (WRF) Forward declarations
-void CHESS( void );
-void JANUS( void );
-void INPUT( void );
-void DISP( void );
-void GNMZ( void );
-void GNMX( void );
-void GNM( void );
-void RUM( void );
-void STRV( void );
-void SNGMV( void );
-void LINE( void );
-void REVERSE( void );
-void CMOVE( void );
-void RESET( void );
-void GENRM( void );
-void UMOVE( void );
-void MOVE( void );
-void CKMATE( void );
-void GO( void );
-void DISMV( void );
-void STRATGY( void );
-void POUT( void );
-void POUT5(void );
-void POUT8(void );
-void POUT9( void );
-void POUT10( void );
-void POUT12( void );
-void POUT13( void );
-void KIN( void );
-void syskin( void );
-void syschout( void );
-void syshexout( void );
-void PrintDig( void );
+void CHESS( mc_engine *mc );
+void COMMAND( mc_engine *mc );
+void JANUS( mc_engine *mc );
+void INPUT( mc_engine *mc );
+void DISP( mc_engine *mc );
+void GNMZ( mc_engine *mc );
+void GNMX( mc_engine *mc );
+void GNM( mc_engine *mc );
+void RUM( mc_engine *mc );
+void STRV( mc_engine *mc );
+void SNGMV( mc_engine *mc );
+void LINE( mc_engine *mc );
+void REVERSE( mc_engine *mc );
+void CMOVE( mc_engine *mc );
+void CHKCHK( mc_engine *mc );
+void CHKGEN( mc_engine *mc );
+void RESET( mc_engine *mc );
+void GENRM( mc_engine *mc );
+void UMOVE( mc_engine *mc );
+void MOVE( mc_engine *mc );
+void CKMATE( mc_engine *mc );
+void GO( mc_engine *mc );
+void DISMV( mc_engine *mc );
+void STRATGY( mc_engine *mc );
+void POUT( mc_engine *mc );
+void POUT5( mc_engine *mc );
+void POUT8( mc_engine *mc );
+void POUT9( mc_engine *mc );
+void POUT10( mc_engine *mc );
+void POUT12( mc_engine *mc );
+void POUT13( mc_engine *mc );
+void KIN( mc_engine *mc );
+void syskin( mc_engine *mc );
+void syschout( mc_engine *mc );
+void syshexout( mc_engine *mc );
+void PrintDig( mc_engine *mc );
+
+// Buffered console output (Part 4)
+#define OUT_SIZE    16384
+static void out_flush( mc_engine *mc );
+static void out_printf( mc_engine *mc, const char *format, ... );
+static int  out_skip_board( mc_engine *mc );
 
 // WRF debug stuff
-static void show_move_evaluation( int ivalue );
-static void show_move_generation( byte src, byte dst );
-static int bool_show_move_evaluation;
-static int bool_show_move_generation;
+static void show_move_evaluation( mc_engine *mc, int ivalue );
+static void show_move_generation( mc_engine *mc, byte src, byte dst );
+
+// Parallel root search (Part 6)
+static void split_search( mc_engine *mc );
+static void pool_stop( mc_engine *mc );
+static int  split_claim( mc_engine *mc );
+static void split_value( mc_engine *mc );
+
+// Bitboard move generator (Part 8)
+static void gnm_bitboard( mc_engine *mc );
+static void gnm_compare( mc_engine *mc );
+static void gen_record( mc_engine *mc );
+
+// Native fast path (Part 15)
+static void janus_native( mc_engine *mc );
+static void janus_compare( mc_engine *mc );
+static void janus_check( mc_engine *mc );
+static void gnm_native( mc_engine *mc );
+static void gnm_native_compare( mc_engine *mc );
+static void cmove_native( mc_engine *mc );
+static void move_native( mc_engine *mc );
+static void umove_native( mc_engine *mc );
+static void reverse_native( mc_engine *mc );
+static byte stratgy_native( mc_engine *mc );
+static void stratgy_check( mc_engine *mc );
+static void native_compare( mc_engine *mc, const char *name,
+                            void (*native)( mc_engine *mc ),
+                            void (*emulated)( mc_engine *mc ) );
+
+// Time control (Part 16)
+static void level_set( mc_engine *mc, int level );
+static void clock_choose( mc_engine *mc );
+static void clock_measure( mc_engine *mc, double elapsed );
+
+// Capture tree pruning (Part 17)
+static void genrm_pruned( mc_engine *mc );
+static void genrm_compare( mc_engine *mc );
+
+// Opening book (Part 18)
+static int  book_move( mc_engine *mc );
+
+// Transposition table (Part 13)
+static void zobrist_move( mc_engine *mc, byte piece, byte from, byte to,
+                                                            byte captured );
+static void zobrist_init( void );
+static int  hash_on4( mc_engine *mc );
+static void hash_on4_store( mc_engine *mc );
+static void hash_genrm( mc_engine *mc );
+static void hash_age( mc_engine *mc );
+
+// Check detection (Part 12)
+static void check_attack( mc_engine *mc );
+static void check_compare( mc_engine *mc );
+
+// Perft (Part 9)
+static void perft_visit( mc_engine *mc );
+
+// Search counters (Part 11)
+static void stats_add( mc_stats *sum, const mc_stats *stats );
+static double seconds( void );
+
+// SIMD kernels (Part 7)
+static void simd_init( void );
+static int  reverse_vector( mc_engine *mc );
+static void bitboard_init( void );
 
 // Start here; Was  *=$1000   ; load into RAM @ $1000-$15FF
-int main( int argc, char* argv[] )
+//  (the host program calls this to play interactively on stdin/stdout)
+int mc_console( mc_engine *mc )
 {
+                mc->out = malloc( OUT_SIZE );   // (WRF) buffered console
+                if( mc->out == NULL )
+                    return( 1 );                // no memory for it
+                mc->bool_console = 1;
+                mc->out_len = 0;
+                mc->discard = 1194;             // skip the opening board
+                mc->board_length = 0;
+                mc->bool_hint = 1;
+                strcpy( mc->in, " CE" );        // start with a CLEAR then
+                mc->in_offset = 1;              //  EXCHANGE command
+                mc->bool_auto = 1;
                 LDAi    (0x00);             // REVERSE TOGGLE
                 STA     (REV);
              // JSR     (Init_6551);
-                if( EXIT != setjmp(jmp_chess) )
-                    CHESS();    // after setjmp() and then any
-                                //  subsequent RESTART_CHESS()
+                do
+                    CHESS( mc );    // one command each time, until
+                while( mc->status != EXIT );    //  EXIT_TO_SYSTEM()
+                out_flush( mc );
+                free( mc->out );
+                mc->out = NULL;
+                mc->bool_console = 0;
                 return(0);  // after EXIT_TO_SYSTEM()
 }
 
-void CHESS( void )
+void CHESS( mc_engine *mc )
 {
-CHESS_BEGIN:                                //
+/*CHESS_BEGIN:*/                            //
                 CLD;                        // INITIALIZE
                 LDXi    (0xFF);             // TWO STACKS
                 TXS;
@@ -429,7 +691,18 @@ CHESS_BEGIN:                                //
 //              CMP     (OLDKY);            // KEY IN ACC  *** no need to debounce
 //              BEQ     (OUT);              // (DEBOUNCE)
 //              STA     (OLDKY);
+                JMP     (COMMAND);          // (fall through)
+}
+
+//
+//       OBEY THE KEY IN ACC, THEN RETURN
+//       WITH STATUS RESTART OR EXIT
+//       (ALSO THE ENTRY POINT FOR A HOST
+//       DRIVING THE ENGINE, MC_STEP)
 //
+void COMMAND( mc_engine *mc )
+{
+                mc->status = RUNNING;
                 CMPi    (0x43);             // [C]
                 BNE     (NOSET);            // SET UP
                 LDXi    (0x1F);             // BOARD
@@ -437,6 +710,7 @@ WHSET:          LDAf    (SETW,X);           // FROM
                 STAx    (BOARD,X);          // SETW
                 DEX;
                 BPL     (WHSET);
+                mailbox_build( mc );
                 LDXi    (0x1B);             // *ADDED
                 STX     (OMOVE);            // INITS TO 0xFF
                 LDAi    (0xCC);             // Display CCC
@@ -455,10 +729,12 @@ NOSET:          CMPi    (0x45);             // [E]
 NOREV:          CMPi    (0x40);             // [P]
                 BNE     (NOGO);             // PLAY CHESS
                 JSR     (GO);
+                if( mc->status != RUNNING ) // GO has played its move
+                    RTS;                    //  and restarted already
 CLDSP:          STA     (DIS1);             // DISPLAY
                 STA     (DIS2);             // ACROSS
                 STA     (DIS3);             // DISPLAY
-                BNE     (CHESS_BEGIN);
+                JMP     (RESTART_CHESS);    // (was BNE CHESS_BEGIN)
 //
 NOGO:           CMPi    (0x0D);             // [Enter]
                 BNE     (NOMV);             // MOVE MAN
@@ -478,8 +754,29 @@ DONE:           JMP     (EXIT_TO_SYSTEM);   // JMP (0xFF00); // *** MUST set thi
 //
 //
 //
-void JANUS( void )
-{               LDX     (STATE);
+void JANUS( mc_engine *mc )
+{               if( mc->record )
+                {
+                    gen_record( mc );       // JUST LIST THE MOVE
+                    RTS;                    //  (SEE GNM_COMPARE)
+                }
+                if( mc->perft && ZP(STATE) == 0 )
+                {
+                    perft_visit( mc );      // COUNT, DON'T ANALYSE
+                    RTS;                    //  (PART 9)
+                }
+                if( mc->work && ZP(STATE) == 4 && !split_claim(mc) )
+                    RTS;                    // ANOTHER THREAD'S ROOT MOVE
+                STAT    (janus);
+                STAT    (janus_state[ZP(STATE)]);
+                if( mc->native == MC_NATIVE_ON )
+                {
+                    janus_native( mc );     // THE SAME IN C
+                    RTS;                    //  (PART 15)
+                }
+                if( mc->native == MC_NATIVE_COMPARE )
+                    janus_compare( mc );    // WHAT C MAKES OF IT
+                LDX     (STATE);
                 BMI     (NOCOUNT);
 //
 //       THIS ROUTINE COUNTS OCCURRENCES
@@ -499,13 +796,12 @@ OVER:           INCx    (MOB,X);            // MOBILITY
                 INCx    (MOB,X);
 //
 NOQ:            BVC     (NOCAP);
-                LDYi    (0x0F);             // CALCULATE
-                LDA     (SQUARE);           // POINTS
-ELOOP:          CMPx    (BK,Y);             // CAPTURED
-                BEQ     (FOUN);             // BY THIS
-                DEY;                        // MOVE
-                BPL     (ELOOP);
-FOUN:           LDAf    (POINTS,Y);
+                LDA     (SQUARE);           // CALCULATE
+/*ELOOP:*/      LDYm;                       // POINTS
+                                            // CAPTURED
+                                            // BY THIS
+                                            // MOVE
+/*FOUN:*/       LDAf    (POINTS,Y);
                 CMPx    (MAXC,X);
                 BCC     (LESS);             // SAVE IF
                 STYx    (PCAP,X);           // BEST THIS
@@ -517,7 +813,9 @@ LESS:           CLC;
                 STAx    (CC,X);             // COUNTS
                 PLP;
 //
-NOCAP:          CPXi    (0x04);
+NOCAP:          if( mc->native == MC_NATIVE_COMPARE )
+                    janus_check( mc );      // SAME COUNTS?
+                CPXi    (0x04);
                 BEQ     (ON4);
                 BMI     (TREE);             //(=00 ONLY)
 XRT:            RTS;
@@ -528,6 +826,10 @@ XRT:            RTS;
 //
 ON4:            LDA     (XMAXC);            // SAVE ACTUAL
                 STA     (WCAP0);            // CAPTURE
+                if( hash_on4( mc ) )        // SEEN THIS POSITION
+                {                           //  BEFORE? (PART 13)
+                    JMP (STRATGY);
+                }
                 LDAi    (0x00);             // STATE=0
                 STA     (STATE);
                 JSR     (MOVE);             // GENERATE
@@ -539,6 +841,7 @@ ON4:            LDA     (XMAXC);            // SAVE ACTUAL
                 STA     (STATE);            // GENERATE
                 JSR     (GNM);              // CONTINUATION
                 JSR     (UMOVE);            // MOVES
+                hash_on4_store( mc );
 //
                 JMP     (STRATGY);          //
 NOCOUNT:        CPXi    (0xF9);
@@ -560,22 +863,25 @@ RETJ:           RTS;
 //      EVALUATE THE EXCHANGE GAIN/LOSS
 //
 TREE:           BVC     (RETJ);             // NO CAP
-                LDYi    (0x07);             // (PIECES)
                 LDA     (SQUARE);
-LOOPX:          CMPx    (BK,Y);
-                BEQ     (FOUNX);
-                DEY;
+/*LOOPX:*/      LDYm;                       // (PIECES)
                 BEQ     (RETJ);             // (KING)
-                BPL     (LOOPX);            // SAVE
-FOUNX:          LDAf    (POINTS,Y);         // BEST CAP
+                CPYi    (0x08);
+                BCS     (RETJ);             // (PAWNS)
+                                            // SAVE
+/*FOUNX:*/      LDAf    (POINTS,Y);         // BEST CAP
                 CMPx    (BCAP0,X);          // AT THIS
                 BCC     (NOMAX);            // LEVEL
                 STAx    (BCAP0,X);
 NOMAX:          DEC     (STATE);
-                LDAf    (&level2,0);        // IF STATE=FB  (WRF, was LDAi (0xFB);)
+                LDAf    (&mc->level2,0);    // IF STATE=FB  (WRF, was LDAi (0xFB);)
                 CMP     (STATE);            // TIME TO TURN
                 BEQ     (UPTREE);           // AROUND
-                JSR     (GENRM);            // GENERATE FURTHER
+                STAT    (genrm);
+                if( mc->hash )
+                    hash_genrm( mc );       // (PART 13)
+                else
+                    JSR (GENRM);            // GENERATE FURTHER
 UPTREE:         INC     (STATE);            // CAPTURES
                 RTS;
 }
@@ -584,7 +890,7 @@ UPTREE:         INC     (STATE);            // CAPTURES
 //
 //      THE PLAYER'S MOVE IS INPUT
 //
-void INPUT( void )
+void INPUT( mc_engine *mc )
 {
                 CMPi    (0x08);             // NOT A LEGAL
                 BCS     (ERROR);            // SQUARE #
@@ -593,15 +899,12 @@ void INPUT( void )
 ERROR:          JMP     (RESTART_CHESS);
 }
 
-void DISP( void )
+void DISP( mc_engine *mc )
 {
-                LDXi    (0x1F);
-SEARCH:         LDAx    (BOARD,X);
-                CMP     (DIS2);
-                BEQ     (HERE);             // DISPLAY
-                DEX;                        // PIECE AT
-                BPL     (SEARCH);           // FROM
-HERE:           STX     (DIS1);             // SQUARE
+                LDA     (DIS2);             // DISPLAY
+/*SEARCH:*/     LDXm;                       // PIECE AT
+                                            // FROM
+/*HERE:*/       STX     (DIS1);             // SQUARE
                 STX     (PIECE);
                 JMP     (RESTART_CHESS);
 }
@@ -612,13 +915,13 @@ HERE:           STX     (DIS1);             // SQUARE
 //      ONE FOR NEXT STEP
 //
 //
-void GNMZ( void )
+void GNMZ( mc_engine *mc )
 {
                 LDXi    (0x10);             // CLEAR
                 JMP     (GNMX);             // fall through
 }
 
-void GNMX( void )
+void GNMX( mc_engine *mc )
 {
                 LDAi    (0x00);             // COUNTERS
 CLEAR:          STAx    (COUNT,X);
@@ -627,8 +930,27 @@ CLEAR:          STAx    (COUNT,X);
                 JMP     (GNM);              // fall though
 }
 
-void GNM( void )
+void GNM( mc_engine *mc )
 {
+                STAT    (gnm);
+                if( mc->generator == MC_GEN_BITBOARD &&
+                    !mc->bool_show_move_generation )
+                {
+                    gnm_bitboard( mc );     // SAME MOVES, SAME
+                    RTS;                    //  ORDER (PART 8)
+                }
+                if( mc->generator == MC_GEN_COMPARE && !mc->record )
+                    gnm_compare( mc );      // CHECK, THEN CONTINUE
+                if( mc->native && !mc->bool_show_move_generation )
+                {
+                    if( mc->native == MC_NATIVE_ON )
+                    {
+                        gnm_native( mc );   // THE SAME IN C
+                        RTS;                //  (PART 15)
+                    }
+                    if( !mc->record )
+                        gnm_native_compare( mc );
+                }
                 LDAi    (0x10);             // SET UP
                 STA     (PIECE);            // PIECE
 NEWP:           DEC     (PIECE);            // NEW PIECE
@@ -702,7 +1024,7 @@ P3:             JSR     (CMOVE);            // AHEAD
 //      CALCULATE SINGLE STEP MOVES
 //      FOR K,N
 //
-void SNGMV( void )
+void SNGMV( mc_engine *mc )
 {
                 JSR     (CMOVE);            // CALC MOVE
                 BMI     (ILL1);             // -IF LEGAL
@@ -716,7 +1038,7 @@ ILL1:           JSR     (RESET);
 //     CALCULATE ALL MOVES DOWN A
 //     STRAIGHT LINE FOR Q,B,R
 //
-void LINE( void )
+void LINE( mc_engine *mc )
 {
 LINE:           JSR     (CMOVE);            // CALC MOVE
                 BCC     (OVL);              // NO CHK
@@ -735,8 +1057,18 @@ ILL:            JSR     (RESET);            // LINE STOPPED
 //      EXCHANGE SIDES FOR REPLY
 //      ANALYSIS
 //
-void REVERSE( void )
+void REVERSE( mc_engine *mc )
 {
+                STAT    (reverse);
+                if( mc->native == MC_NATIVE_ON )
+                {
+                    reverse_native( mc );   // THE SAME IN C
+                    RTS;                    //  (PART 15)
+                }
+                if( mc->native == MC_NATIVE_COMPARE )
+                    native_compare( mc, "REVERSE", reverse_native, REVERSE );
+                if( reverse_vector( mc ) )  // SSE2/AVX2 VERSION
+                    BRA     (FLIP);         //  OF THE LOOP BELOW
                 LDXi    (0x0F);
 ETC:            SEC;
                 LDYx    (BK,X);             // SUBTRACT
@@ -750,6 +1082,11 @@ ETC:            SEC;
                 STAx    (BOARD,X);
                 DEX;
                 BPL     (ETC);
+FLIP:           mc->mailbox_sq ^= 0x77;     // MAILBOX TOO
+                mc->mailbox_pc ^= 0x10;
+                mc->key ^= mc->rkey;        // AND THE
+                mc->rkey ^= mc->key;        // ZOBRIST KEYS
+                mc->key ^= mc->rkey;
                 RTS;
 }
 //
@@ -763,11 +1100,21 @@ ETC:            SEC;
 //        WHO WROTE THIS MORE EFFICIENT
 //        VERSION OF CMOVE]
 //
-void CMOVE( void )
+void CMOVE( mc_engine *mc )
 {
     byte src;
+                STAT    (cmove);
+                if( mc->native && !mc->bool_show_move_generation )
+                {
+                    if( mc->native == MC_NATIVE_ON )
+                    {
+                        cmove_native( mc ); // THE SAME IN C
+                        RTS;                //  (PART 15)
+                    }
+                    native_compare( mc, "CMOVE", cmove_native, CMOVE );
+                }
                 LDA     (SQUARE);           // GET SQUARE
-                src     = reg_a;
+                src     = mc->reg_a;
                 LDX     (MOVEN);            // MOVE POINTER
                 CLC;
                 ADCf    (MOVEX,X);          // MOVE LIST
@@ -775,15 +1122,13 @@ void CMOVE( void )
                 ANDi    (0x88);
                 BNE     (ILLEGAL);          // OFF BOARD
                 LDA     (SQUARE);
-                if( bool_show_move_generation )
-                    show_move_generation( src, reg_a );
+                if( mc->bool_show_move_generation )
+                    show_move_generation( mc, src, mc->reg_a );
 
 //
-                LDXi    (0x20);
-LOOP:           DEX;                        // IS TO
+/*LOOP:*/       LDXm;                       // IS TO
                 BMI     (NO);               // SQUARE
-                CMPx    (BOARD,X);          // OCCUPIED?
-                BNE     (LOOP);
+                                            // OCCUPIED?
 //
                 CPXi    (0x10);             // BY SELF?
                 BMI     (ILLEGAL);
@@ -795,10 +1140,14 @@ LOOP:           DEX;                        // IS TO
 //
 NO:             CLV;                        // NO CAPTURE
 //
-SPX:            LDA     (STATE);            // SHOULD WE
-                BMI     (RETL);             // DO THE
-                CMPf    (&level1,0);        // CHECK CHECK? (WRF: was CMPi (0x08);)
-                BPL     (RETL);
+SPX:            JMP     (CHKCHK);           // (fall through)
+//
+ILLEGAL:        LDAi    (0xFF);
+                CLC;                        // ILLEGAL
+                CLV;                        // RETURN
+                RTS;
+}
+
 //
 //        CHKCHK REVERSES SIDES
 //       AND LOOKS FOR A KING
@@ -807,8 +1156,49 @@ SPX:            LDA     (STATE);            // SHOULD WE
 //       CHECK  SINCE THIS IS
 //       TIME CONSUMING, IT IS NOT
 //       ALWAYS DONE
+//       (WRF) SEPARATE ROUTINE SO THE
+//        BITBOARD GENERATOR CAN USE IT.
+//        NOW LOOKS OUT FROM THE KING
+//        FOR AN ATTACKER INSTEAD OF
+//        GENERATING THE REPLIES, SEE
+//        PART 12
+//
+void CHKCHK( mc_engine *mc )
+{
+                LDA     (STATE);            // SHOULD WE
+                BMI     (RETL);             // DO THE
+                CMPf    (&mc->level1,0);    // CHECK CHECK? (WRF: was CMPi (0x08);)
+                BPL     (RETL);
+//
+                STAT    (chkchk);
+                if( mc->bool_show_move_generation ||
+                    mc->generator == MC_GEN_COMPARE )
+                    JSR (CHKGEN);           // GENERATE REPLIES
+                else
+                    check_attack( mc );     // OR JUST LOOK
+                LDA     (INCHEK);
+                BMI     (RETL);             // NO - SAFE
+                SEC;                        // YES - IN CHK
+                LDAi    (0xFF);
+                RTS;
+//
+RETL:           CLC;                        // LEGAL
+                LDAi    (0x00);             // RETURN
+                RTS;
+}
+
 //
-/*CHKCHK:*/     PHA;                        // STATE
+//       (WRF) THE ORIGINAL CHECK TEST,
+//        STILL USED TO SHOW THE MOVES
+//        GENERATED AND TO VERIFY
+//        CHECK_ATTACK (MC_GEN_COMPARE)
+//
+void CHKGEN( mc_engine *mc )
+{
+    gen_list *record;
+                record  = mc->record;       // (replies are not recorded)
+                mc->record = NULL;
+                PHA;                        // STATE
                 PHP;
                 LDAi    (0xF9);
                 STA     (STATE);            // GENERATE
@@ -820,26 +1210,16 @@ SPX:            LDA     (STATE);            // SHOULD WE
                 PLP;
                 PLA;
                 STA     (STATE);
-                LDA     (INCHEK);
-                BMI     (RETL);             // NO - SAFE
-                SEC;                        // YES - IN CHK
-                LDAi    (0xFF);
-                RTS;
-//
-RETL:           CLC;                        // LEGAL
-                LDAi    (0x00);             // RETURN
-                RTS;
-//
-ILLEGAL:        LDAi    (0xFF);
-                CLC;                        // ILLEGAL
-                CLV;                        // RETURN
+                mc->record = record;
+                if( mc->generator == MC_GEN_COMPARE )
+                    check_compare( mc );
                 RTS;
 }
 
 //
 //       REPLACE PIECE ON CORRECT SQUARE
 //
-void RESET( void )
+void RESET( mc_engine *mc )
 {
                 LDX     (PIECE);            // GET LOGAT
                 LDAx    (BOARD,X);          // FOR PIECE
@@ -851,15 +1231,24 @@ void RESET( void )
 //
 //
 //
-void GENRM( void )
+void GENRM( mc_engine *mc )
 {
+                if( mc->pruning && !mc->bool_show_move_generation
+                                && !mc->bool_show_move_evaluation )
+                {
+                    if( mc->pruning == MC_PRUNE_ON )
+                        genrm_pruned( mc );     // (PART 17)
+                    else
+                        genrm_compare( mc );
+                    RTS;
+                }
                 JSR     (MOVE);             // MAKE MOVE
 /*GENR2:*/      JSR     (REVERSE);          // REVERSE BOARD
                 JSR     (GNM);              // GENERATE MOVES
                 JMP     (RUM);              // fall through
 }
 
-void RUM( void )
+void RUM( mc_engine *mc )
 {
                 JSR     (REVERSE);          // REVERSE BACK
                 JMP     (UMOVE);            // fall through
@@ -869,8 +1258,15 @@ void RUM( void )
 //       ROUTINE TO UNMAKE A MOVE MADE BY
 //         MOVE
 //
-void UMOVE( void )
+void UMOVE( mc_engine *mc )
 {
+                if( mc->native == MC_NATIVE_ON )
+                {
+                    umove_native( mc );     // THE SAME IN C
+                    RTS;                    //  (PART 15)
+                }
+                if( mc->native == MC_NATIVE_COMPARE )
+                    native_compare( mc, "UMOVE", umove_native, UMOVE );
                 TSX;                        // UNMAKE MOVE
                 STX     (SP1);
                 LDX     (SP2);              // EXCHANGE
@@ -882,11 +1278,15 @@ void UMOVE( void )
                 TAX;
                 PLA;                        // FROM SQUARE
                 STAx    (BOARD,X);
+                mailbox_put( mc, mc->reg_a, mc->reg_x );
                 PLA;                        // PIECE
                 TAX;
                 PLA;                        // TO SOUARE
                 STA     (SQUARE);
                 STAx    (BOARD,X);
+                mailbox_put( mc, mc->reg_a, mc->reg_x );
+                zobrist_move( mc, ZP(PIECE), ZP(BOARD+ZP(PIECE)),
+                                            ZP(SQUARE), mc->reg_x );
                 JMP     (STRV);
 }
 
@@ -896,26 +1296,35 @@ void UMOVE( void )
 //       ARE SAVED IN A STACK TO UNMAKE
 //       THE MOVE LATER
 //
-void MOVE( void )
-{               TSX;
+void MOVE( mc_engine *mc )
+{               STAT    (move);
+                if( mc->native == MC_NATIVE_ON )
+                {
+                    move_native( mc );      // THE SAME IN C
+                    RTS;                    //  (PART 15)
+                }
+                if( mc->native == MC_NATIVE_COMPARE )
+                    native_compare( mc, "MOVE", move_native, MOVE );
+                TSX;
                 STX     (SP1);              // SWITCH
                 LDX     (SP2);              // STACKS
                 TXS;
                 LDA     (SQUARE);
                 PHA;                        // TO SQUARE
                 TAY;
-                LDXi    (0x1F);
-CHECK:          CMPx    (BOARD,X);          // CHECK FOR
-                BEQ     (TAKE);             // CAPTURE
-                DEX;
-                BPL     (CHECK);
-TAKE:           LDAi    (0xCC);
+/*CHECK:*/      LDXm;                       // CHECK FOR
+                                            // CAPTURE
+                zobrist_move( mc, ZP(PIECE), ZP(BOARD+ZP(PIECE)),
+                                            mc->reg_y, mc->reg_x );
+/*TAKE:*/       LDAi    (0xCC);
                 STAx    (BOARD,X);
                 TXA;                        // CAPTURED
                 PHA;                        // PIECE
                 LDX     (PIECE);
                 LDAx    (BOARD,X);
                 STYx    (BOARD,X);          // FROM
+                mailbox_put( mc, mc->reg_a, EMPTY );
+                mailbox_put( mc, mc->reg_y, mc->reg_x );
                 PHA;                        // SQUARE
                 TXA;
                 PHA;                        // PIECE
@@ -929,7 +1338,7 @@ TAKE:           LDAi    (0xCC);
 //  would need to enhance 6502 stack emulation to incorporate our
 //  subroutine mechanism, instead we simply use the native C stack for
 //  subroutine return addresses).
-void STRV( void )
+void STRV( mc_engine *mc )
 {
                 TSX;
                 STX     (SP2);              // SWITCH
@@ -943,7 +1352,7 @@ void STRV( void )
 //       -CHECKS FOR CHECK OR CHECKMATE
 //       AND ASSIGNS VALUE TO MOVE
 //
-void CKMATE( void )
+void CKMATE( mc_engine *mc )
 {
                 LDX     (BMAXC);            // CAN BLK CAP
                 CPXf    (POINTS,0);         // MY KING?
@@ -964,13 +1373,15 @@ RETV:           LDXi    (0x04);             // RESTORE
 //       IS COMPARED TO THE BEST MOVE AND
 //       REPLACES IT IF IT IS BETTER
 //
-                if( bool_show_move_evaluation )
-                    show_move_evaluation( reg_a );
+                if( mc->bool_show_move_evaluation )
+                    show_move_evaluation( mc, mc->reg_a );
+                if( mc->work )
+                    split_value( mc );      // let split_search() compare
 /*PUSH:*/       CMP     (BESTV);            // IS THIS BEST
                 BCC     (RETP);             // MOVE SO FAR?
                 BEQ     (RETP);
-                if( bool_show_move_evaluation )
-                    printf( "NEW BEST MOVE\n" );
+                if( mc->bool_show_move_evaluation )
+                    out_printf( mc, "NEW BEST MOVE\n" );
                 STA     (BESTV);            // YES!
                 LDA     (PIECE);            // SAVE IT
                 STA     (BESTP);
@@ -984,8 +1395,17 @@ RETP:           LDAi    ('.');              // print ... instead of flashing dis
 //       MAIN PROGRAM TO PLAY CHESS
 //       PLAY FROM OPENING OR THINK
 //
-void GO( void )
+void GO( mc_engine *mc )
 {
+    double start;
+                memset( &mc->stats, 0, sizeof(mc->stats) );
+                hash_age( mc );             // (PART 13)
+                if( mc->book )
+                {
+                    ZP(OMOVE) = 0xff;       // BOOK FILE IN PLACE
+                    if( book_move( mc ) )   // OF OPNING (PART 18)
+                        BRA (MV2);
+                }
                 LDX     (OMOVE);            // OPENING?
                 BMI     (NOOPEN);           // -NO   *ADD CHANGE FROM BPL
                 LDA     (DIS3);             // -YES WAS
@@ -1003,7 +1423,8 @@ void GO( void )
 //
 END:            LDAi    (0xFF);             // *ADD - STOP CANNED MOVES
                 STA     (OMOVE);            // FLAG OPENING
-NOOPEN:         LDXi    (0x0C);             // FINISHED
+NOOPEN:         start = seconds();
+                LDXi    (0x0C);             // FINISHED
                 STX     (STATE);            // STATE=C
                 STX     (BESTV);            // CLEAR BESTV
                 LDXi    (0x14);             // GENERATE P
@@ -1011,12 +1432,18 @@ NOOPEN:         LDXi    (0x0C);             // FINISHED
 //
                 LDXi    (0x04);             // STATE=4
                 STX     (STATE);            // GENERATE AND
-                JSR     (GNMZ);             // TEST AVAILABLE
+                if( mc->threads > 1 && !mc->bool_show_move_evaluation
+                                    && !mc->bool_show_move_generation )
+                    split_search( mc );     // (SAME AS GNMZ, PARALLEL)
+                else
+                    JSR (GNMZ);             // TEST AVAILABLE
 //                                             MOVES
+                mc->stats.seconds = seconds() - start;
 //
                 LDX     (BESTV);            // GET BEST MOVE
                 CPXi    (0x0F);             // IF NONE
                 BCC     (MATE);             // OH OH!
+                mc->score = mc->reg_x;      // keep value for mc_go()
 //
 MV2:            LDX     (BESTP);            // MOVE
                 LDAx    (BOARD,X);          // THE
@@ -1035,7 +1462,7 @@ MATE:           LDAi    (0xFF);             // RESIGN
 //       SUBROUTINE TO ENTER THE
 //       PLAYER'S MOVE
 //
-void DISMV( void )
+void DISMV( mc_engine *mc )
 {
                 LDXi    (0x04);             // ROTATE
 DROL:           ASL     (DIS3);             // KEY
@@ -1054,8 +1481,13 @@ DROL:           ASL     (DIS3);             // KEY
 //       CONSIDERATION AND RETURNS IT IN
 //       THE ACCUMULATOR
 //
-void STRATGY( void )
+void STRATGY( mc_engine *mc )
 {
+                if( mc->native == MC_NATIVE_ON )
+                {
+                    mc->reg_a = stratgy_native( mc );   // THE SAME IN C
+                    JMP (CKMATE);                       //  (PART 15)
+                }
                 CLC;
                 LDAi    (0x80);
                 ADC     (WMOB);             // PARAMETERS
@@ -1110,7 +1542,9 @@ POS:            LSR;
                 BPL     (NOPOSN);
 POSN:           CLC;
                 ADCi    (0x02);
-NOPOSN:         JMP     (CKMATE);           // CONTINUE
+NOPOSN:         if( mc->native == MC_NATIVE_COMPARE )
+                    stratgy_check( mc );    // SAME VALUE?
+                JMP     (CKMATE);           // CONTINUE
 }
 
 //**********************************************************************
@@ -1132,8 +1566,10 @@ char banner[] = "MicroChess (c) 1976-2005 Peter Jennings, www.benlo.com\r\n";
 char cpl[]    = "WWWWWWWWWWWWWWWWBBBBBBBBBBBBBBBBWWWWWWWWWWWWWWWW";
 char cph[]    = "KQRRBBNNPPPPPPPPKQRRBBNNPPPPPPPP";
 
-void POUT( void )
-{               JSR     (POUT9);            // print CRLF
+void POUT( mc_engine *mc )
+{               if( out_skip_board( mc ) )  // (WRF) not going to be seen
+                    RTS;
+                JSR     (POUT9);            // print CRLF
                 JSR     (POUT13);           // print copyright
                 JSR     (POUT10);           // print column labels
                 LDYi    (0x00);             // init board location
@@ -1192,7 +1628,7 @@ POUT42:         JSR     (syschout);         //
                 BNE     (POUT3);            // branch always
 }
 
-void POUT5( void )
+void POUT5( mc_engine *mc )
 {
                 TXA;                        // print "-----...-----<crlf>"
                 PHA;
@@ -1207,7 +1643,7 @@ POUT6:          JSR     (syschout);         // PRINT ONE ASCII CHR - "-"
                 RTS;
 }
 
-void POUT8( void )
+void POUT8( mc_engine *mc )
 {
                 JSR     (POUT10);           //
                 LDA     (0xFB);
@@ -1223,7 +1659,7 @@ void POUT8( void )
                 JMP     (POUT9);            // fall through
 }
 
-void POUT9( void )
+void POUT9( mc_engine *mc )
 {
                 LDAi    (0x0D);
                 JSR     (syschout);         // PRINT ONE ASCII CHR - CR
@@ -1232,7 +1668,7 @@ void POUT9( void )
                 RTS;
 }
 
-void POUT10( void )
+void POUT10( mc_engine *mc )
 {
                 LDXi    (0x00);             // print the column labels
 POUT11:         LDAi    (0x20);             // 00 01 02 03 ... 07 <CRLF>
@@ -1246,7 +1682,7 @@ POUT11:         LDAi    (0x20);             // 00 01 02 03 ... 07 <CRLF>
                 JMP     (POUT12);           // fall through
 }
 
-void POUT12( void )
+void POUT12( mc_engine *mc )
 {
                 TYA;
                 ANDi    (0x70);
@@ -1254,7 +1690,7 @@ void POUT12( void )
                 RTS;
 }
 
-void POUT13( void )
+void POUT13( mc_engine *mc )
 {
                 LDXi    (0x00);             // Print the copyright banner
 POUT14:         LDAf    (banner,X);
@@ -1265,7 +1701,7 @@ POUT14:         LDAf    (banner,X);
 POUT15:         RTS;
 }
 
-void KIN( void )
+void KIN( mc_engine *mc )
 {
                 LDAi    ('?');
                 JSR     (syschout);         // PRINT ONE ASCII CHR - ?
@@ -1311,7 +1747,7 @@ ACIA_Out1      lda   ACIASta                // serial port status
 */
 
 // Print as hex digits
-void syshexout( void )
+void syshexout( mc_engine *mc )
 {
                PHA;                         //  prints AA hex digits
                LSR;                         //  MOVE UPPER NIBBLE TO LOWER
@@ -1323,7 +1759,7 @@ void syshexout( void )
                JMP   (PrintDig);            // fall through
 }
 
-void PrintDig( void )
+void PrintDig( mc_engine *mc )
 {
                char Hexdigdata[] = "0123456789ABCDEF";
                ANDi  (0x0F);                //  prints A hex nibble (low 4 bits)
@@ -1345,10 +1781,12 @@ void PrintDig( void )
 //**********************************************************************
 
 // Misc prototypes
-static char algebraic_file( byte square );
-static char algebraic_rank( byte square );
-static char octal_file( char file );
-static char octal_rank( char rank );
+static void console_perft( mc_engine *mc, int depth, int bool_divide );
+static void console_stats( mc_engine *mc );
+static char algebraic_file( mc_engine *mc, byte square );
+static char algebraic_rank( mc_engine *mc, byte square );
+static char octal_file( mc_engine *mc, char file );
+static char octal_rank( mc_engine *mc, char rank );
 
 // Here are the commands available in the enhanced interface
 static char help[] =
@@ -1369,6 +1807,12 @@ static char help[] =
     " hh     ;piece editor, view piece location, eg 01, computer's queen\n"
     " hh=xx  ;piece editor, set piece location, eg 01=64 or 01=e2\n"
     " hh=    ;piece editor, clear piece, eg 01=, delete computer's queen\n"
+    " perft n;count positions n moves deep (move generator test)\n"
+    " div n  ;as perft, also counting below each of the program's moves\n"
+    " stats  ;what the program's last move search looked at\n"
+    " fen    ;show position as FEN, the program to move\n"
+    " fen x  ;set up position x given as FEN, the program plays the side\n"
+    "        ; to move\n"
     " m      ;debugging, toggle move generation information dump\n"
     " v      ;debugging, toggle move evaluation information dump\n"
     "        ;Note that the debugging features are very verbose and best\n"
@@ -1385,68 +1829,146 @@ static char help[] =
 #endif
 
 // Forward declaration of smart in/out alternatives
-void smart_out( char c );
-char smart_in( void );
+void smart_out( mc_engine *mc, char c );
+char smart_in( mc_engine *mc );
 
 // Character in
-void syskin( void )
+void syskin( mc_engine *mc )
 {
     #ifdef PRIMITIVE_INTERFACE
-    reg_a = (byte)getch();
+    mc->reg_a = (byte)getch();
     #else
-    reg_a = (byte)smart_in();
+    mc->reg_a = (byte)smart_in( mc );
     #endif
 }
 
-// Character out
-void syschout( void )
+// Character out, an embedded engine (no console) stays silent
+void syschout( mc_engine *mc )
 {
+    if( !mc->bool_console )
+        return;
     #ifdef PRIMITIVE_INTERFACE
-    putch( (int)reg_a );
+    putch( (int)mc->reg_a );
     #else
-    smart_out( (char)reg_a );
+    smart_out( mc, (char)mc->reg_a );
     #endif
 }
 
+// Console output buffer (OUT_SIZE bytes), written to stdout when the
+//  next command is read (or when full), rather than a character at a time
+
+static void out_flush( mc_engine *mc )
+{
+    if( mc->out && mc->out_len )
+    {
+        fwrite( mc->out, 1, mc->out_len, stdout );
+        fflush( stdout );
+        mc->out_len = 0;
+    }
+}
+
+static void out_char( mc_engine *mc, char c )
+{
+    if( mc->out_len == OUT_SIZE )
+        out_flush( mc );
+    mc->out[mc->out_len++] = c;
+}
+
+// printf() to the console buffer (straight to stdout without a console,
+//  eg the debug dumps of an embedded engine)
+static void out_printf( mc_engine *mc, const char *format, ... )
+{
+    va_list args;
+    int n;
+    if( mc->out == NULL )
+    {
+        va_start( args, format );
+        vprintf( format, args );
+        va_end( args );
+        return;
+    }
+    va_start( args, format );
+    n = vsnprintf( mc->out+mc->out_len, OUT_SIZE-mc->out_len, format, args );
+    va_end( args );
+    if( n >= OUT_SIZE-mc->out_len )     // didn't fit, make room
+    {
+        out_flush( mc );
+        va_start( args, format );
+        if( n < OUT_SIZE )
+            n = vsnprintf( mc->out, OUT_SIZE, format, args );
+        else
+        {
+            vprintf( format, args );    // too big to buffer at all
+            n = 0;
+        }
+        va_end( args );
+    }
+    mc->out_len += n;
+}
+
 // Smart character out, supplements enhanced interface of smart_in()
-static int discard = 1194;  // Discard until initial CLEAR and EXCHANGE
-                            //  commands are complete
     // The discard mechanism optionally discards characters - this is
     //  useful because the smart_in() routine works by converting higher
     //  level commands into a a series of primitive commands. The discard
     //  mechanism allows us to skip over (discard) the board displays
     //  generated for all of the intermediate primitive commands.
     //  The values assigned to discard are in each case determined by
-    //  simple trial and error
-void smart_out( char c )
+    //  simple trial and error. (WRF) Boards wholly discarded are not
+    //  drawn at all, see out_skip_board()
+void smart_out( mc_engine *mc, char c )
 {
-    static char first='?';  // replace first '?' with message below
-    if( discard )
-        discard--;
+    if( mc->discard )
+        mc->discard--;
     else
     {
-        if( first && c==first )
+        if( mc->bool_hint && c=='?' ) // replace first '?' with message
         {
-            printf( " (type ? for help)\n?" );
-            first = '\0';
+            out_printf( mc, " (type ? for help)\n?" );
+            mc->bool_hint = 0;
         }
         else
         {
             if( c != '\r' )//printf converts "\n" to "\r\n" so don't need "\r"
-                printf( "%c", c );
+                out_char( mc, c );
         }
     }
 }
 
+// POUT, is the whole board going to be discarded ? If so don't draw it,
+//  just count it as discarded. (Every board is the same length, measured
+//  by drawing the first one into the discard count)
+static int out_skip_board( mc_engine *mc )
+{
+    if( !mc->bool_console )
+        return( 1 );                // nowhere to draw it
+    #ifdef PRIMITIVE_INTERFACE
+    return( 0 );
+    #endif
+    if( mc->board_length < 0 )
+        return( 0 );                // measuring
+    if( mc->board_length == 0 )
+    {
+        int discard = mc->discard;
+        mc->discard = INT_MAX;
+        mc->board_length = -1;
+        POUT( mc );
+        mc->board_length = INT_MAX - mc->discard;
+        mc->discard = discard;
+    }
+    if( mc->discard < mc->board_length )
+        return( 0 );
+    mc->discard -= mc->board_length;
+    return( 1 );
+}
+
 // Smart character in, provides a help screen + algebraic notation interface
 //  + position editor + diagnostics commands etc.
-char smart_in( void )
+char smart_in( mc_engine *mc )
 {
     static char error[] = "Illegal or unknown command, type ? for help\n?";
-    static char buf[20] = " CE";  // start with a CLEAR then EXCHANGE command
-    static int offset=1;
-    static int bool_auto=1;
+    char *buf = mc->in;
     char color, file, rank, file2, rank2, ch='\0';
+    char fen[sizeof(mc->in)];
     int i, len, bool_okay;
     byte piece, square;
     char *s;
@@ -1455,28 +1977,37 @@ char smart_in( void )
     byte bool_white = ZP(REV);
 
     // Emit buffered commands until '\0'
-    if( offset )
-        ch = buf[offset++];
+    if( mc->in_offset )
+        ch = buf[mc->in_offset++];
 
     // Loop until command ready
     while( ch == '\0' )
     {
 
         // Reset grooming machinery
-        offset  = 0;
-        discard = 2;    // remove initial "\r\n"
+        mc->in_offset = 0;
+        mc->discard = 2;    // remove initial "\r\n"
 
         // Reset flag indicating entry of a legal command handled internally
         //  (i.e. within this function, without passing characters to
         //  underlying microchess implementation)
         bool_okay = 0;
 
-        // Get edited command line
-        if( NULL == fgets(buf,sizeof(buf)-1,stdin) )
-            EXIT_TO_SYSTEM();
+        // Get edited command line, everything up to the prompt shown first
+        out_flush( mc );
+        if( NULL == fgets(buf,sizeof(mc->in)-1,stdin) )
+            ch = 'Q';   // end of input, quit the game
         else
         {
 
+            // Keep the case of a FEN (the command's argument)
+            for( s=buf; *s==' ' || *s=='\t'; s++ )
+                ;
+            strcpy( fen, s );
+            s = strchr( fen, '\n' );
+            if( s )
+                *s = '\0';
+
             // Convert to lower case, zap '\n'
             for( s=buf; *s; s++ )
             {
@@ -1509,10 +2040,10 @@ char smart_in( void )
                 '1'<=buf[3] && buf[3]<='8'
               )
             {
-                file  = octal_file(buf[0]);
-                rank  = octal_rank(buf[1]);
-                file2 = octal_file(buf[2]);
-                rank2 = octal_rank(buf[3]);
+                file  = octal_file(mc,buf[0]);
+                rank  = octal_rank(mc,buf[1]);
+                file2 = octal_file(mc,buf[2]);
+                rank2 = octal_rank(mc,buf[3]);
                 buf[0] = rank;     // specify move microchess grid style
                 buf[1] = file;     //
                 buf[2] = rank2;    //
@@ -1527,18 +2058,18 @@ char smart_in( void )
                 '0'<=buf[3] && buf[3]<='7'
               )
             {
-                offset = 1;         // emit from here next
-                if( bool_auto )
+                mc->in_offset = 1;  // emit from here next
+                if( mc->bool_auto )
                 {
                     buf[4] = '\r';   // play move
                     buf[5] = 'p';    // get response
                     buf[6] = '\0';   // done
-                    discard = 2386;  // skip over intermediate board displays
+                    mc->discard = 2386;  // skip intermediate board displays
                 }
                 else
                 {
                     buf[4] = '\0';   // done
-                    discard = 1790;  // skip over intermediate board displays
+                    mc->discard = 1790;  // skip intermediate board displays
                 }
             }
 
@@ -1548,23 +2079,51 @@ char smart_in( void )
               )
             {
                 bool_okay = 1;
+                mc_set_level( mc, buf[1]-'0' );
                 switch( buf[1] )
                 {
-                    case '1':   level1 = 0;
-                                level2 = 0xff;
-                                printf( "Level 1, super blitz\n" );
+                    case '1':   out_printf( mc, "Level 1, super blitz\n" );
                                 break;  // (on 6502: 3 seconds per move)
-                    case '2':   level1 = 0;
-                                level2 = 0xfb;
-                                printf( "Level 2, blitz\n" );
+                    case '2':   out_printf( mc, "Level 2, blitz\n" );
                                 break;  // (on 6502: 10 seconds per move)
-                    case '3':   level1 = 8;
-                                level2 = 0xfb;
-                                printf( "Level 3, normal\n" );
+                    case '3':   out_printf( mc, "Level 3, normal\n" );
                                 break;  // (on 6502: 100 seconds per move)
                 }
             }
 
+            // Is it a perft command ?
+            else if( (len==7 && 0==strncmp(buf,"perft ",6)) ||
+                     (len==5 && 0==strncmp(buf,"div ",4))      )
+            {
+                if( '1'<=buf[len-1] && buf[len-1]<='9' )
+                {
+                    bool_okay = 1;
+                    console_perft( mc, buf[len-1]-'0', buf[0]=='d' );
+                }
+            }
+
+            // Is it a FEN command ?
+            else if( 0==strcmp(buf,"fen") || 0==strncmp(buf,"fen ",4) )
+            {
+                bool_okay = 1;
+                if( len == 3 )
+                {
+                    mc_get_fen( mc, fen );
+                    out_printf( mc, "%s\n", fen );
+                }
+                else if( MC_OK != mc_set_fen(mc,fen+4) )
+                    out_printf( mc, "Can't set up that position\n" );
+                else
+                    POUT( mc );
+            }
+
+            // Is it the stats command ?
+            else if( len==5 && 0==strcmp(buf,"stats") )
+            {
+                bool_okay = 1;
+                console_stats( mc );
+            }
+
             // Is it a single letter command ?
             else if( len == 1 )
             {
@@ -1575,7 +2134,7 @@ char smart_in( void )
                     //  (step 3) interface
                     case 'c':   ch = 'C';   break;
                     case 'e':   ch = 'E';   break;
-                    case 'p':   ch = 'P';   discard=0;  // no initial "\r\n"
+                    case 'p':   ch = 'P';   mc->discard=0;  // no initial "\r\n"
                                             break;
                     case 'q':   ch = 'Q';   break;
                     case 'f':   ch = '\r';  break;
@@ -1584,27 +2143,27 @@ char smart_in( void )
                     case 'a':
                     {
                         bool_okay = 1;
-                        bool_auto = !bool_auto;
-                        printf( "Auto play now %s\n",
-                                            bool_auto ? "enabled"
+                        mc->bool_auto = !mc->bool_auto;
+                        out_printf( mc, "Auto play now %s\n",
+                                            mc->bool_auto ? "enabled"
                                                       : "disabled" );
                         break;
                     }
                     case 'm':
                     {
                         bool_okay = 1;
-                        bool_show_move_generation = !bool_show_move_generation;
-                        printf( "Show move generation now %s\n",
-                                 bool_show_move_generation ? "enabled"
+                        mc->bool_show_move_generation = !mc->bool_show_move_generation;
+                        out_printf( mc, "Show move generation now %s\n",
+                                 mc->bool_show_move_generation ? "enabled"
                                                            : "disabled" );
                         break;
                     }
                     case 'v':
                     {
                         bool_okay = 1;
-                        bool_show_move_evaluation = !bool_show_move_evaluation;
-                        printf( "Show move evaluation now %s\n",
-                                 bool_show_move_evaluation ? "enabled"
+                        mc->bool_show_move_evaluation = !mc->bool_show_move_evaluation;
+                        out_printf( mc, "Show move evaluation now %s\n",
+                                 mc->bool_show_move_evaluation ? "enabled"
                                                            : "disabled" );
                         break;
                     }
@@ -1616,8 +2175,8 @@ char smart_in( void )
                     case 'w':
                     {
                         strcpy( buf, bool_white?"ece":"ce" );
-                        discard = bool_white?1194:598;
-                        offset = 1; // emit from here next
+                        mc->discard = bool_white?1194:598;
+                        mc->in_offset = 1;  // emit from here next
                         break;
                     }
 
@@ -1628,8 +2187,8 @@ char smart_in( void )
                     case 'b':
                     {
                         strcpy( buf, bool_white?"ecp":"cp" );
-                        discard = bool_white?1194:598;
-                        offset = 1; // emit from here next
+                        mc->discard = bool_white?1194:598;
+                        mc->in_offset = 1;  // emit from here next
                         break;
                     }
                 }
@@ -1638,7 +2197,7 @@ char smart_in( void )
             // Algebraic castling - emit as two half moves
             else if( 0==strcmp(buf,"oo") || 0==strcmp(buf,"ooo") )
             {
-                if( bool_auto )
+                if( mc->bool_auto )
                 {
                     if( 0 == strcmp(buf,"oo") )
                         strcpy( buf, bool_white ? "7476\r7775\rp"
@@ -1646,12 +2205,12 @@ char smart_in( void )
                     else
                         strcpy( buf, bool_white ? "7472\r7073\rp"
                                                 : "7375\r7774\rp" );
-                    offset = 1;
-                    discard = 5422; // skip intermediate boards
+                    mc->in_offset = 1;
+                    mc->discard = 5422; // skip intermediate boards
                 }
                 else
                 {
-                    printf( "Castling only available in auto play mode"
+                    out_printf( mc, "Castling only available in auto play mode"
                             " (use \'a\' command)\n" );
                     bool_okay = 1;
                 }
@@ -1681,8 +2240,8 @@ char smart_in( void )
                   )
                 {
                     bool_okay = 1;   // algebraic edit
-                    file = octal_file(buf[3]);
-                    rank = octal_rank(buf[4]);
+                    file = octal_file(mc,buf[3]);
+                    rank = octal_rank(mc,buf[4]);
                 }
 
                 // If piece editor command with correct syntax
@@ -1713,47 +2272,50 @@ char smart_in( void )
                     else if( len == 3 )
                         ZP(BOARD+piece) = 0xcc; // microchess convention
 
+                    mailbox_build( mc );
+
                     // Report on the color and type of piece ...
                     if( piece < 16 )
                         color = bool_white?'B':'W';
                     else
                         color = bool_white?'W':'B';
-                    printf( "Piece %c%c is %s %c%c ", buf[0], buf[1],
+                    out_printf( mc, "Piece %c%c is %s %c%c ", buf[0], buf[1],
                                         (piece&0x0f) < 2 ? "the" : "a",
                                         color,
                                         "KQRRBBNNPPPPPPPP"[piece&0x0f] );
 
                     // ... and the square it (now) occupies
                     if( square & 0x88 )
-                        printf( "and is not on the board\n" );
+                        out_printf( mc, "and is not on the board\n" );
                     else
                     {
-                        printf( "%son square %02x",
-                                           len==3?"previously ":"",
-                                           square );
-                        printf( " (algebraic %c%c)", algebraic_file(square),
-                                                     algebraic_rank(square) );
+                        out_printf( mc, "%son square %02x",
+                                            len==3?"previously ":"",
+                                            square );
+                        out_printf( mc, " (algebraic %c%c)",
+                                            algebraic_file(mc,square),
+                                            algebraic_rank(mc,square) );
                         if( len == 3 )
-                            printf( " now deleted" );
-                        printf("\n");
+                            out_printf( mc, " now deleted" );
+                        out_printf( mc, "\n" );
                     }
-                    POUT();
+                    POUT( mc );
                 }
             }
 
             // Emit the first of a buffered series of commands ?
-            if( offset )
+            if( mc->in_offset )
                 ch = buf[0];
 
             // If still no command available, illegal or unknown command
             if( ch == '\0' )
             {
                 if( len==0 || bool_okay ) // if bool_okay internal command 
-                    printf( "?" );
+                    out_printf( mc, "?" );
                 else if( buf[0] == '?' )
-                    printf( help );
+                    out_printf( mc, "%s", help );
                 else
-                    printf( error );
+                    out_printf( mc, "%s", error );
             }
         }
     }
@@ -1762,7 +2324,7 @@ char smart_in( void )
 
 
 // Show internally generated move
-void show_move_generation( byte src, byte dst )
+void show_move_generation( mc_engine *mc, byte src, byte dst )
 {
     static byte lookup[64] =
     {
@@ -1782,12 +2344,12 @@ void show_move_generation( byte src, byte dst )
     byte square, piece;
 
     // Indent according to state
-    printf( "\n" );
+    out_printf( mc, "\n" );
     if( ZP(STATE) >= 0xf5 )
         indent = (ZP(STATE)-0xf5)*4;
     else
         indent = ZP(STATE);
-    printf( strchr(spaces,'\0') - indent );
+    out_printf( mc, "%s", strchr(spaces,'\0') - indent );
 
     // Print two characters for each square
     for( i=0; i<64; i++ )
@@ -1802,29 +2364,29 @@ void show_move_generation( byte src, byte dst )
                 break;
             }
         }
-        printf( "%c", ch );
+        out_printf( mc, "%c", ch );
         if( square == src )
-            printf( "*" );  // highlight src square like this
+            out_printf( mc, "*" );  // highlight src square like this
         else if( square == dst )
-            printf( "@" );  // highlight dst square like this
+            out_printf( mc, "@" );  // highlight dst square like this
         else
-            printf( " " );  // normally no hightlight
+            out_printf( mc, " " );  // normally no hightlight
 
         // Next row
         if( (i&7) == 7 )
         {
-            printf( "\n" );
-            printf( strchr(spaces,'\0') - indent );
+            out_printf( mc, "\n" );
+            out_printf( mc, "%s", strchr(spaces,'\0') - indent );
         }
     }
 
     // Also show the most important debug variable information
-    printf( "state=%02x ", ZP(STATE) );
+    out_printf( mc, "state=%02x ", ZP(STATE) );
 }
 
 
 // Show numeric move evaluation
-static void show_move_evaluation( int ivalue )
+static void show_move_evaluation( mc_engine *mc, int ivalue )
 {
 
     // Compare ivalue calculated by microchess with independently calculated
@@ -1850,10 +2412,10 @@ static void show_move_evaluation( int ivalue )
     byte bmob  = ZP(BMOB );
 
     // Show move
-    printf( "\nEvaluating move %c-%c%c\n",
+    out_printf( mc, "\nEvaluating move %c-%c%c\n",
                              "KQRRBBNNpppppppp"[ZP(PIECE)&0x0f],
-                             algebraic_file(ZP(SQUARE)),
-                             algebraic_rank(ZP(SQUARE)) );
+                             algebraic_file(mc,ZP(SQUARE)),
+                             algebraic_rank(mc,ZP(SQUARE)) );
 
     // Calculate weighted sum
     value =   4.00 * (wcap0)
@@ -1864,40 +2426,42 @@ static void show_move_evaluation( int ivalue )
             - 2.00 * (bcc)
             - 1.25 * (bcap1)
             - 0.25 * (pmaxc + pcc + pmob + bcap0 + bcap2 + bmob);
-    printf( "(+4)    WCAP0=%u\n", wcap0 );
-    printf( "(+1.25) WCAP1=%u\n", wcap1 );
-    printf( "(+0.75) WMAXC=%u WCC=%u\n", wmaxc, wcc );
-    printf( "(+0.25) WMOB =%u WCAP2=%u\n", wmob, wcap2  );
-    printf( "(-2.50) BMAXC=%u\n", bmaxc );
-    printf( "(-2.00) BCC  =%u\n", bcc   );
-    printf( "(-1.25) BCAP1=%u\n", bcap1 );
-    printf( "(-0.25) PMAXC=%u PCC=%u PMOB=%u BCAP0=%u BCAP2=%u BMOB=%u\n",
+    out_printf( mc, "(+4)    WCAP0=%u\n", wcap0 );
+    out_printf( mc, "(+1.25) WCAP1=%u\n", wcap1 );
+    out_printf( mc, "(+0.75) WMAXC=%u WCC=%u\n", wmaxc, wcc );
+    out_printf( mc, "(+0.25) WMOB =%u WCAP2=%u\n", wmob, wcap2  );
+    out_printf( mc, "(-2.50) BMAXC=%u\n", bmaxc );
+    out_printf( mc, "(-2.00) BCC  =%u\n", bcc   );
+    out_printf( mc, "(-1.25) BCAP1=%u\n", bcap1 );
+    out_printf( mc,
+              "(-0.25) PMAXC=%u PCC=%u PMOB=%u BCAP0=%u BCAP2=%u BMOB=%u\n",
                      pmaxc, pcc, pmob, bcap0, bcap2, bmob  );
-    printf( "Weighted sum        = %f\n", value  );
+    out_printf( mc, "Weighted sum        = %f\n", value  );
 
     // Calculate scaled weighted sum, corresponds to single byte value used
     //  internally by microchess
     svalue = (int)floor(208.0 + value);  // 208 = 0x90+0x40 from STRATGY();
-    printf( "Scaled weighted sum = %d\n", svalue );
+    out_printf( mc, "Scaled weighted sum = %d\n", svalue );
 
     // Comment on correspondence (or otherwise) of two values
-    printf( "Move value = %d"  , ivalue );
+    out_printf( mc, "Move value = %d"  , ivalue );
     if( ivalue == 0 )
-        printf( " (minimum, I'm in check?)\n", ivalue );
+        out_printf( mc, " (minimum, I'm in check?)\n", ivalue );
     else if( ivalue == 255 )
-        printf( " (maximum, I'm delivering mate?)\n", ivalue );
+        out_printf( mc, " (maximum, I'm delivering mate?)\n", ivalue );
     else if( ivalue == svalue )
-        printf( " (=scaled weighted sum)\n" );
+        out_printf( mc, " (=scaled weighted sum)\n" );
     else if( ivalue == svalue+2 )
-        printf( " (=scaled weighted sum plus 2 bonus points)\n" );
+        out_printf( mc, " (=scaled weighted sum plus 2 bonus points)\n" );
     else
-        printf( " (unexpected value, suspect overflow or underflow)\n" );
-    printf( "best so far = %u\n", ZP(BESTV) );
+        out_printf( mc,
+                    " (unexpected value, suspect overflow or underflow)\n" );
+    out_printf( mc, "best so far = %u\n", ZP(BESTV) );
 }
 
 
 // Get algebraic file 'a'-'h' from octal square
-static char algebraic_file( byte square )
+static char algebraic_file( mc_engine *mc, byte square )
 {
     char file = square & 0x0f;
     byte bool_white = ZP(REV);
@@ -1910,7 +2474,7 @@ static char algebraic_file( byte square )
 
 
 // Get algebraic rank '1'-'8' from octal square
-static char algebraic_rank( byte square )
+static char algebraic_rank( mc_engine *mc, byte square )
 {
     char rank = (square>>4) & 0x0f;
     byte bool_white = ZP(REV);
@@ -1923,7 +2487,7 @@ static char algebraic_rank( byte square )
 
 
 // Get microchess file '0'-'7' from algebraic file 'a'-'h'
-static char octal_file( char file )
+static char octal_file( mc_engine *mc, char file )
 {
     byte bool_white = ZP(REV);
     if( bool_white )
@@ -1935,7 +2499,7 @@ static char octal_file( char file )
 
 
 // Get microchess rank '0'-'7' from algebraic rank '1'-'8'
-static char octal_rank( char rank )
+static char octal_rank( mc_engine *mc, char rank )
 {
     byte bool_white = ZP(REV);
     if( bool_white )
@@ -1944,3 +2508,3081 @@ static char octal_rank( char rank )
         rank = '0' + (rank-'1');  // eg '1'->'0', '8'->'7'
     return( rank );
 }
+
+
+//**********************************************************************
+//*
+//*  Part 5
+//*  ------
+//*  Embedding interface, see microchess.h. Lets a host program drive
+//*  any number of engines directly, without the text interface.
+//**********************************************************************
+
+// Create an independent engine, zero page and stacks cleared, NORMAL level
+mc_engine *mc_create( void )
+{
+    mc_engine *mc = (mc_engine *)calloc( 1, sizeof(mc_engine) );
+    simd_init();
+    bitboard_init();
+    if( mc )
+    {
+        mc_set_level( mc, MC_LEVEL_NORMAL );
+        mc->threads = 1;
+        mc->native  = MC_NATIVE_ON;
+        mc->pruning = MC_PRUNE_ON;
+        mc_seed_book( mc, 0 );
+        mc_set_hash( mc, MC_HASH_DEFAULT );
+        mailbox_build( mc );
+        ZP(OMOVE) = 0xff;   // no opening book until mc_new_game()
+    }
+    return( mc );
+}
+
+// Release an engine created by mc_create()
+void mc_destroy( mc_engine *mc )
+{
+    pool_stop( mc );
+    mc_set_hash( mc, 0 );
+    mc_set_book( mc, NULL );
+    free( mc );
+}
+
+// Reset both stacks, as CHESS does before each command
+static void reset_stacks( mc_engine *mc )
+{
+                LDXi    (0xFF);             // TWO STACKS
+                TXS;
+                LDXi    (0xC8);
+                STX     (SP2);
+}
+
+// Set search level, 1 (super blitz) to 3 (normal), as the "ln" command.
+//  With the clock on (Part 16) it takes effect once the clock is off
+int mc_set_level( mc_engine *mc, int level )
+{
+    if( level < MC_LEVEL_SUPER_BLITZ || level > MC_LEVEL_NORMAL )
+        return( MC_ERROR );
+    mc->fixed_level = level;
+    if( !mc->clock_on )
+        level_set( mc, level );
+    return( MC_OK );
+}
+
+// The level the last search was made at, or the next will be
+int mc_get_level( mc_engine *mc )
+{
+    return( mc->level );
+}
+
+// Set up level1 and level2 for a (valid) level
+static void level_set( mc_engine *mc, int level )
+{
+    mc->level = level;
+    switch( level )
+    {
+        case MC_LEVEL_SUPER_BLITZ:  mc->level1 = 0;
+                                    mc->level2 = 0xff;
+                                    break;
+        case MC_LEVEL_BLITZ:        mc->level1 = 0;
+                                    mc->level2 = 0xfb;
+                                    break;
+        case MC_LEVEL_NORMAL:       mc->level1 = 8;
+                                    mc->level2 = 0xfb;
+                                    break;
+    }
+}
+
+// Start a new game from the initial position, as the "c" (plus "e" if
+//  the computer is to play black) commands
+void mc_new_game( mc_engine *mc, int computer_white )
+{
+    int i;
+    for( i=0; i<32; i++ )
+        ZP(BOARD+i) = SETW[i];
+    mailbox_build( mc );
+    ZP(OMOVE) = 0x1b;
+    ZP(DIS1)  = ZP(DIS2) = ZP(DIS3) = 0xCC;  // as [C], the book's first
+    ZP(REV)   = 0;                          //  entry expects it
+    if( !computer_white )
+        mc_reverse( mc );
+}
+
+// Load a position; squares[0..15] are the computer's pieces (BOARD),
+//  squares[16..31] the opponent's (BK), in the microchess piece order
+//  KQRRBBNNPPPPPPPP. Captured pieces are MC_CAPTURED. The opening book is
+//  switched off
+void mc_set_position( mc_engine *mc, const unsigned char squares[32],
+                                                            int reversed )
+{
+    int i;
+    for( i=0; i<32; i++ )
+        ZP(BOARD+i) = squares[i];
+    mailbox_build( mc );
+    ZP(REV)   = reversed ? 1 : 0;
+    ZP(OMOVE) = 0xff;
+}
+
+// Read back the position in the form accepted by mc_set_position()
+int mc_get_position( mc_engine *mc, unsigned char squares[32] )
+{
+    int i;
+    for( i=0; i<32; i++ )
+        squares[i] = ZP(BOARD+i);
+    return( ZP(REV) );
+}
+
+// Set up a position from FEN. The side to move becomes the computer
+//  (BOARD), the other side BK, and REV is set to match. Pieces fill the
+//  KQRRBBNNPPPPPPPP slots in the order FEN lists them; a position needing
+//  more pieces of a kind than there are slots (eg a second queen) can't
+//  be set up. Castling, en passant and the move counters are ignored.
+//  The opening book is used only for the initial position, white to move
+int mc_set_fen( mc_engine *mc, const char *fen )
+{
+    static const char start[] = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR";
+    static const char kinds[] = "kqrbnp";
+    static const byte first[] = { 0, 1, 2, 4, 6, 8 };   // slots of
+    static const byte last[]  = { 0, 1, 3, 5, 7, 15 };  //  each kind
+    unsigned char squares[MC_PIECES];
+    const char *s, *kind;
+    int file=0, rank=7, white, computer_black, side, i, slot;
+
+    for( s=fen; *s && *s!=' '; s++ )
+        ;
+    while( *s == ' ' )
+        s++;
+    if( *s!='w' && *s!='b' )
+        return( MC_ERROR );
+    computer_black = (*s == 'b');
+    if( computer_black==0 && 0==strncmp(fen,start,sizeof(start)-1) &&
+                                            fen[sizeof(start)-1]==' ' )
+    {
+        mc_new_game( mc, 1 );
+        return( MC_OK );
+    }
+
+    memset( squares, MC_CAPTURED, sizeof(squares) );
+    for( s=fen; *s && *s!=' '; s++ )
+    {
+        if( *s == '/' )
+        {
+            if( file != 8 || rank == 0 )
+                return( MC_ERROR );
+            file = 0;
+            rank--;
+        }
+        else if( '1'<=*s && *s<='8' )
+            file += *s-'0';
+        else
+        {
+            kind = strchr( kinds, tolower((unsigned char)*s) );
+            if( kind==NULL || file > 7 )
+                return( MC_ERROR );
+            white = isupper( (unsigned char)*s ) != 0;
+            side = (white == computer_black) ? 0x10 : 0;   // BK : BOARD
+            i = kind - kinds;
+            for( slot=first[i]; slot<=last[i]; slot++ )
+            {
+                if( squares[side|slot] == MC_CAPTURED )
+                    break;
+            }
+            if( slot > last[i] )
+                return( MC_ERROR ); // no slot free for this piece
+            squares[side|slot] = computer_black ? (7-rank)<<4 | file
+                                                : rank<<4 | (7-file);
+            file++;
+        }
+        if( file > 8 )
+            return( MC_ERROR );
+    }
+    if( file!=8 || rank!=0 || squares[0]==MC_CAPTURED ||
+                                    squares[0x10]==MC_CAPTURED )
+        return( MC_ERROR );         // every square and both kings
+    mc_set_position( mc, squares, computer_black );
+    return( MC_OK );
+}
+
+// Describe the position as FEN, the computer to move
+void mc_get_fen( mc_engine *mc, char fen[MC_FEN_MAX] )
+{
+    char board[8][8];
+    int file, rank, i, empty;
+    byte square;
+    char *s = fen;
+
+    memset( board, 0, sizeof(board) );
+    for( i=0; i<MC_PIECES; i++ )
+    {
+        square = ZP(BOARD+i);
+        if( square & 0x88 )
+            continue;               // captured
+        file = algebraic_file( mc, square ) - 'a';
+        rank = algebraic_rank( mc, square ) - '1';
+        board[rank][file] = "KQRRBBNNPPPPPPPP"[i&0x0f];
+        if( (i<0x10) == (ZP(REV)!=0) )
+            board[rank][file] = tolower( board[rank][file] );  // black
+    }
+    for( rank=7; rank>=0; rank-- )
+    {
+        empty = 0;
+        for( file=0; file<8; file++ )
+        {
+            if( board[rank][file] == 0 )
+                empty++;
+            else
+            {
+                if( empty )
+                    *s++ = '0' + empty;
+                empty = 0;
+                *s++ = board[rank][file];
+            }
+        }
+        if( empty )
+            *s++ = '0' + empty;
+        if( rank )
+            *s++ = '/';
+    }
+    sprintf( s, " %c - - 0 1", ZP(REV) ? 'b' : 'w' );
+}
+
+// Exchange sides, as the "e" command
+void mc_reverse( mc_engine *mc )
+{
+    REVERSE( mc );
+    ZP(REV) = 1 - ZP(REV);
+}
+
+// Move whatever piece stands on square "from" to square "to", capturing
+//  anything there, as a move entered at the console followed by [Enter]
+int mc_apply_move( mc_engine *mc, unsigned char from, unsigned char to )
+{
+    byte piece;
+    if( (from&0x88) || (to&0x88) )
+        return( MC_ERROR );
+    piece = mailbox_find( mc, from );
+    if( piece == EMPTY )
+        return( MC_ERROR );
+    reset_stacks( mc );
+    ZP(DIS1) = ZP(PIECE) = piece;
+    ZP(DIS2) = from;
+    ZP(DIS3) = ZP(SQUARE) = to;
+    MOVE( mc );
+    return( MC_OK );
+}
+
+// Let the computer choose and play its move, as the "p" command
+int mc_go( mc_engine *mc, mc_move *best )
+{
+    int mated = 0;
+    double start = seconds();
+    if( mc->clock_on )
+        clock_choose( mc );         // (Part 16)
+    reset_stacks( mc );
+    mc->score  = 0;
+    mc->status = RUNNING;
+    GO( mc );
+    if( mc->clock_on )
+        clock_measure( mc, seconds() - start );
+    if( mc->status != RESTART ) // no move to play
+    {
+        mated = 1;
+        ZP(DIS1) = ZP(DIS2) = ZP(DIS3) = 0xff;
+    }
+    if( best )
+    {
+        best->piece = ZP(DIS1);
+        best->from  = ZP(DIS2);
+        best->to    = ZP(DIS3);
+        best->value = mc->score;
+    }
+    return( mated ? MC_MATE : MC_OK );
+}
+
+// Obey one primitive microchess command key, exactly as if typed at the
+//  original program's "?" prompt but without the board display; 'C' set
+//  up, 'E' exchange sides, 'P' play, '0'-'7' enter a square digit, '\r'
+//  make the move entered, 'Q' quit. Returns MC_OK or MC_EXIT
+int mc_step( mc_engine *mc, int key )
+{
+    reset_stacks( mc );
+    mc->reg_f = mc->reg_a = (byte)key;
+    ANDi    (0x4F);     // same mask as KIN
+    COMMAND( mc );
+    return( mc->status );
+}
+
+// Describe a move in algebraic notation, eg "e2e4"
+void mc_move_text( mc_engine *mc, const mc_move *move, char text[5] )
+{
+    text[0] = algebraic_file( mc, move->from );
+    text[1] = algebraic_rank( mc, move->from );
+    text[2] = algebraic_file( mc, move->to );
+    text[3] = algebraic_rank( mc, move->to );
+    text[4] = '\0';
+}
+
+// Read a move in algebraic notation, eg "e2e4", as squares for
+//  mc_apply_move()
+int mc_parse_move( mc_engine *mc, const char *text, unsigned char *from,
+                                                        unsigned char *to )
+{
+    int i;
+    for( i=0; i<4; i+=2 )
+    {
+        if( text[i]<'a' || 'h'<text[i] || text[i+1]<'1' || '8'<text[i+1] )
+            return( MC_ERROR );
+    }
+    *from = (octal_rank(mc,text[1])-'0')<<4 | (octal_file(mc,text[0])-'0');
+    *to   = (octal_rank(mc,text[3])-'0')<<4 | (octal_file(mc,text[2])-'0');
+    return( MC_OK );
+}
+
+// Choose the move generator, MC_GEN_6502 (the original), MC_GEN_BITBOARD
+//  or MC_GEN_COMPARE (run both, play with the original, count mismatches)
+int mc_set_generator( mc_engine *mc, int generator )
+{
+    if( generator < MC_GEN_6502 || generator > MC_GEN_COMPARE )
+        return( MC_ERROR );
+    mc->generator = generator;
+    return( MC_OK );
+}
+
+// Number of positions in which the generators disagreed (MC_GEN_COMPARE)
+long mc_generator_mismatches( mc_engine *mc )
+{
+    return( mc->mismatches );
+}
+
+// Choose how the hot routines run, MC_NATIVE_ON (C versions, the
+//  default), MC_NATIVE_OFF (the 6502 emulation) or MC_NATIVE_COMPARE (run
+//  both, play with the emulation, count mismatches), see Part 15
+int mc_set_native( mc_engine *mc, int mode )
+{
+    if( mode < MC_NATIVE_OFF || mode > MC_NATIVE_COMPARE )
+        return( MC_ERROR );
+    mc->native = mode;
+    return( MC_OK );
+}
+
+// Number of times the C and emulated routines disagreed (MC_NATIVE_COMPARE)
+long mc_native_mismatches( mc_engine *mc )
+{
+    return( mc->native_mismatches );
+}
+
+// Choose how the capture tree is searched, MC_PRUNE_ON (captures only,
+//  best first, cut off once nothing more can be found, the default),
+//  MC_PRUNE_OFF (every reply, as the original) or MC_PRUNE_COMPARE (run
+//  both, play with the original, count mismatches), see Part 17
+int mc_set_pruning( mc_engine *mc, int mode )
+{
+    if( mode < MC_PRUNE_OFF || mode > MC_PRUNE_COMPARE )
+        return( MC_ERROR );
+    mc->pruning = mode;
+    return( MC_OK );
+}
+
+// Number of capture trees pruning got wrong (MC_PRUNE_COMPARE)
+long mc_pruning_mismatches( mc_engine *mc )
+{
+    return( mc->pruning_mismatches );
+}
+
+// Set the number of threads GO uses to search the root moves, 1 (the
+//  default) searches them serially exactly as the original program
+int mc_set_threads( mc_engine *mc, int threads )
+{
+    if( threads < 1 || threads > MC_MAX_THREADS )
+        return( MC_ERROR );
+    if( threads != mc->threads )
+        pool_stop( mc );    // the next parallel GO starts a new pool
+    mc->threads = threads;
+    return( MC_OK );
+}
+
+
+//**********************************************************************
+//*
+//*  Part 6
+//*  ------
+//*  Parallel root search. GO evaluates each of its root moves (STATE=4)
+//*  independently of the others; GNMZ clears every counter JANUS
+//*  accumulates for a root move before the next one is looked at, so
+//*  the value STRATGY gives a move depends only on the position. Each
+//*  worker runs the whole root move generation on its own copy of the
+//*  engine, claims root moves first come first served, and evaluates
+//*  only those it claimed. The values are then compared in generation
+//*  order, just as CKMATE does serially, so the same move is chosen.
+//**********************************************************************
+
+#define MAX_ROOT    256     // far more moves than any position has
+
+struct split
+{
+    pthread_mutex_t lock;
+    byte claimed[MAX_ROOT]; // root move taken by a worker
+    byte owner  [MAX_ROOT]; // by which worker
+    byte value  [MAX_ROOT]; // value STRATGY and CKMATE assigned it
+    byte piece  [MAX_ROOT]; // the move itself
+    byte square [MAX_ROOT];
+    int  nroot;             // root moves generated
+};
+
+typedef struct worker
+{
+    pthread_t thread;
+    pool *pool;
+    mc_engine engine;
+} worker;
+
+// Worker threads kept from one GO to the next. Each GO bumps
+//  "generation" and wakes them; they search and count "busy" down
+struct pool
+{
+    pthread_mutex_t lock;
+    pthread_cond_t start;   // a new GO, or quit
+    pthread_cond_t done;    // busy has reached 0
+    unsigned generation;
+    int busy;
+    int quit;
+    int size;               // workers, 0 searching on the GO thread
+    worker *workers;
+    split work;
+};
+
+// JANUS at STATE=4, is this root move ours to evaluate ?
+static int split_claim( mc_engine *mc )
+{
+    split *work = mc->work;
+    int k = mc->root++;
+    int mine = 0;
+    if( k < MAX_ROOT )
+    {
+        pthread_mutex_lock( &work->lock );
+        if( !work->claimed[k] )
+        {
+            work->claimed[k] = 1;
+            work->owner[k]   = (byte)mc->id;
+            mine = 1;
+        }
+        if( k >= work->nroot )
+            work->nroot = k+1;
+        pthread_mutex_unlock( &work->lock );
+    }
+    return( mine );
+}
+
+// CKMATE, record the value of the root move we claimed
+static void split_value( mc_engine *mc )
+{
+    split *work = mc->work;
+    int k = mc->root-1;
+    if( k < MAX_ROOT )
+    {
+        work->value [k] = mc->reg_a;
+        work->piece [k] = ZP(PIECE);
+        work->square[k] = ZP(SQUARE);
+    }
+}
+
+// One worker thread of the pool, waits for a GO and searches it
+static void *pool_thread( void *arg )
+{
+    worker *w = arg;
+    pool *p = w->pool;
+    unsigned generation = 0;
+
+    pthread_mutex_lock( &p->lock );
+    for(;;)
+    {
+        while( !p->quit && p->generation == generation )
+            pthread_cond_wait( &p->start, &p->lock );
+        if( p->quit )
+            break;
+        generation = p->generation;
+        pthread_mutex_unlock( &p->lock );
+        GNMZ( &w->engine );
+        pthread_mutex_lock( &p->lock );
+        if( --p->busy == 0 )
+            pthread_cond_signal( &p->done );
+    }
+    pthread_mutex_unlock( &p->lock );
+    return( NULL );
+}
+
+// Start "threads" workers, the first of them the GO thread itself. Fewer
+//  if threads can't be created, none at all if there's no memory
+static void pool_start( mc_engine *mc )
+{
+    pool *p = (pool *)calloc( 1, sizeof(pool) );
+    int i;
+
+    if( p == NULL )
+        return;
+    p->workers = (worker *)calloc( mc->threads, sizeof(worker) );
+    if( p->workers == NULL )
+    {
+        free( p );
+        return;
+    }
+    pthread_mutex_init( &p->lock, NULL );
+    pthread_cond_init( &p->start, NULL );
+    pthread_cond_init( &p->done, NULL );
+    pthread_mutex_init( &p->work.lock, NULL );
+    for( i=0; i<mc->threads; i++ )
+        p->workers[i].pool = p;
+    for( i=1; i<mc->threads; i++ )
+    {
+        if( 0 != pthread_create( &p->workers[i].thread, NULL, pool_thread,
+                                                        &p->workers[i] ) )
+            break;  // carry on with fewer threads
+    }
+    p->size = i;
+    mc->pool = p;
+}
+
+// Stop and join the worker threads, if any were started
+static void pool_stop( mc_engine *mc )
+{
+    pool *p = mc->pool;
+    int i;
+
+    if( p == NULL )
+        return;
+    pthread_mutex_lock( &p->lock );
+    p->quit = 1;
+    pthread_cond_broadcast( &p->start );
+    pthread_mutex_unlock( &p->lock );
+    for( i=1; i<p->size; i++ )
+        pthread_join( p->workers[i].thread, NULL );
+    pthread_mutex_destroy( &p->work.lock );
+    pthread_cond_destroy( &p->done );
+    pthread_cond_destroy( &p->start );
+    pthread_mutex_destroy( &p->lock );
+    free( p->workers );
+    free( p );
+    mc->pool = NULL;
+}
+
+// Generate and evaluate the root moves in parallel, leaving BESTV, BESTP
+//  and BESTM (and the rest of zero page) as GNMZ would have
+static void split_search( mc_engine *mc )
+{
+    pool *p;
+    split *work;
+    worker *workers;
+    int i, n;
+    byte bestv = ZP(BESTV), bestp = ZP(BESTP), bestm = ZP(BESTM);
+
+    if( mc->pool == NULL )
+        pool_start( mc );
+    if( mc->pool == NULL )
+    {
+        GNMZ( mc );     // no memory, search serially
+        return;
+    }
+    p = mc->pool;
+    work = &p->work;
+    workers = p->workers;
+    n = p->size;
+    memset( work->claimed, 0, sizeof(work->claimed) );
+    work->nroot = 0;
+
+    // Each worker searches a copy of the whole engine. The copy keeps the
+    //  hash pointer, so all of them share one transposition table: that
+    //  is intended (a root move's replies are cached for the others) and
+    //  safe without locks as an entry is checked against its key xor'ed
+    //  with its data, see Part 13. The book file is shared too, it is
+    //  only read; the copies are never destroyed, so take no reference
+    for( i=0; i<n; i++ )
+    {
+        workers[i].engine = *mc;
+        workers[i].engine.pool         = NULL;
+        workers[i].engine.work         = work;
+        workers[i].engine.id           = i;
+        workers[i].engine.root         = 0;
+        workers[i].engine.bool_console = 0;
+        memset( &workers[i].engine.stats, 0, sizeof(mc_stats) );
+    }
+    pthread_mutex_lock( &p->lock );
+    p->busy = n-1;
+    p->generation++;
+    pthread_cond_broadcast( &p->start );
+    pthread_mutex_unlock( &p->lock );
+    GNMZ( &workers[0].engine );
+    pthread_mutex_lock( &p->lock );
+    while( p->busy )
+        pthread_cond_wait( &p->done, &p->lock );
+    pthread_mutex_unlock( &p->lock );
+    for( i=0; i<n; i++ )
+    {
+        stats_add( &mc->stats, &workers[i].engine.stats );
+    }
+
+    // Zero page as left by the last root move evaluated, then the best
+    //  move found by comparing values in generation order
+    i = work->nroot ? work->owner[work->nroot-1] : 0;
+    memcpy( mc->zeropage, workers[i].engine.zeropage, sizeof(mc->zeropage) );
+    memcpy( mc->mailbox,  workers[i].engine.mailbox,  sizeof(mc->mailbox) );
+    mc->mailbox_sq = workers[i].engine.mailbox_sq;
+    mc->mailbox_pc = workers[i].engine.mailbox_pc;
+    for( i=0; i<work->nroot; i++ )
+    {
+        if( work->value[i] > bestv )
+        {
+            bestv = work->value[i];
+            bestp = work->piece[i];
+            bestm = work->square[i];
+        }
+        mc->reg_a = '.';    // print ... as CKMATE does for each move
+        syschout( mc );
+    }
+    ZP(BESTV) = bestv;
+    ZP(BESTP) = bestp;
+    ZP(BESTM) = bestm;
+}
+
+
+//**********************************************************************
+//*
+//*  Part 7
+//*  ------
+//*  SIMD kernels. REVERSE is two 16 byte "subtract from 0x77" operations
+//*  and a swap, and runs twice for every reply generated in GENRM, RUM
+//*  and CHKCHK. The best kernel the CPU supports is picked once, at run
+//*  time; without one (or built with MC_NO_SIMD) the emulated 6502 loop
+//*  is used. (The other 16 byte scans, of BK in JANUS, are answered by
+//*  the square to piece mailbox instead, see LDYm)
+//**********************************************************************
+
+#if !defined(MC_NO_SIMD) && defined(__GNUC__) && \
+                                (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+// Kernel exchanging and mirroring the 32 byte piece list BOARD+BK
+static void (*reverse_kernel)( byte *pieces );
+static pthread_once_t simd_once = PTHREAD_ONCE_INIT;
+
+#ifdef SIMD_X86
+__attribute__((target("sse2")))
+static void reverse_sse2( byte *pieces )
+{
+    __m128i k77   = _mm_set1_epi8( 0x77 );
+    __m128i board = _mm_loadu_si128( (__m128i *)pieces );
+    __m128i bk    = _mm_loadu_si128( (__m128i *)(pieces+16) );
+    _mm_storeu_si128( (__m128i *)pieces,      _mm_sub_epi8(k77,bk) );
+    _mm_storeu_si128( (__m128i *)(pieces+16), _mm_sub_epi8(k77,board) );
+}
+
+__attribute__((target("avx2")))
+static void reverse_avx2( byte *pieces )
+{
+    __m256i v = _mm256_loadu_si256( (__m256i *)pieces );
+    v = _mm256_sub_epi8( _mm256_set1_epi8(0x77), v );
+    v = _mm256_permute2x128_si256( v, v, 0x01 );    // swap BOARD, BK
+    _mm256_storeu_si256( (__m256i *)pieces, v );
+}
+#endif
+
+static void simd_select( void )
+{
+    #ifdef SIMD_X86
+    __builtin_cpu_init();
+    if( __builtin_cpu_supports("avx2") )
+        reverse_kernel = reverse_avx2;
+    else if( __builtin_cpu_supports("sse2") )
+        reverse_kernel = reverse_sse2;
+    #endif
+}
+
+static void simd_init( void )
+{
+    pthread_once( &simd_once, simd_select );
+}
+
+// REVERSE using the vector kernel, leaving the registers as the 6502
+//  loop would. Returns 0 if there is no kernel for this CPU
+static int reverse_vector( mc_engine *mc )
+{
+    byte bk0 = ZP(BK);
+    if( reverse_kernel == NULL )
+        return( 0 );
+    reverse_kernel( &ZP(BOARD) );
+    mc->reg_y  = bk0;
+    mc->reg_a  = ZP(BOARD);
+    mc->reg_cy = (0x77 >= bk0);
+    mc->reg_x  = 0xff;
+    mc->reg_f  = 0xff;
+    return( 1 );
+}
+
+
+//**********************************************************************
+//*
+//*  Part 8
+//*  ------
+//*  Bitboard move generator. An alternative to GNM that keeps 64 bit
+//*  occupancy boards for both sides, built from BOARD and BK, and walks
+//*  precomputed rays instead of stepping with CMOVE and RESET. It offers
+//*  JANUS exactly the moves GNM would, in the same order (pieces 0F to
+//*  00, directions in MOVEN order, nearest square first) with the same
+//*  PIECE, SQUARE, MOVEN and V flag, and uses CHKCHK the same way, so
+//*  the search is unchanged. MC_GEN_COMPARE lists the moves of both
+//*  generators for every position and reports any difference.
+//**********************************************************************
+
+typedef unsigned long long bitboard;
+
+// Squares reachable from each square in each of the MOVEN 1-8 ray
+//  directions, on an empty board
+static bitboard ray[9][64];
+static pthread_once_t bitboard_once = PTHREAD_ONCE_INIT;
+
+#define SQ64(sq)    ( ((sq)>>4)*8 + ((sq)&7) )
+#define SQ88(i)     ( (byte)( ((i)/8)*16 + ((i)&7) ) )
+#define BIT(sq)     ( (bitboard)1 << SQ64(sq) )
+
+static void bitboard_rays( void )
+{
+    int moven, i;
+    byte sq;
+    for( moven=1; moven<=8; moven++ )
+    {
+        for( i=0; i<64; i++ )
+        {
+            for( sq=SQ88(i)+MOVEX[moven]; !(sq&0x88); sq+=MOVEX[moven] )
+                ray[moven][i] |= BIT(sq);
+        }
+    }
+}
+
+static void bitboard_init( void )
+{
+    pthread_once( &bitboard_once, bitboard_rays );
+}
+
+// Offer one move to JANUS after the test for check CMOVE would make,
+//  returns 1 if it was illegal because of check (and not offered)
+static int bb_offer( mc_engine *mc, byte moven, byte square, int capture )
+{
+    ZP(MOVEN)  = moven;
+    ZP(SQUARE) = square;
+    mc->reg_v  = capture;
+    CHKCHK( mc );
+    if( mc->reg_cy )
+        return( 1 );
+    JANUS( mc );
+    return( 0 );
+}
+
+// A king or knight step, as SNGMV
+static void bb_step( mc_engine *mc, byte from, byte moven,
+                                            bitboard own, bitboard opp )
+{
+    byte to = from + MOVEX[moven];
+    if( (to&0x88) || (own&BIT(to)) )
+        return;
+    bb_offer( mc, moven, to, (opp&BIT(to)) != 0 );
+}
+
+// A queen, rook or bishop ray, as LINE. Squares are offered nearest
+//  first, which is lowest bit first when the direction adds to the
+//  square and highest bit first when it subtracts
+static void bb_line( mc_engine *mc, byte from, byte moven,
+                                            bitboard own, bitboard opp )
+{
+    int up = !(MOVEX[moven] & 0x80);
+    bitboard moves = ray[moven][SQ64(from)];
+    bitboard block = moves & (own|opp);
+    int i;
+    if( block )
+    {
+        i = up ? __builtin_ctzll(block) : 63-__builtin_clzll(block);
+        moves &= ~ray[moven][i];    // nothing beyond the first piece
+        moves &= ~own;              // which we can't take if it's ours
+    }
+    while( moves )
+    {
+        i = up ? __builtin_ctzll(moves) : 63-__builtin_clzll(moves);
+        moves &= ~((bitboard)1 << i);
+        bb_offer( mc, moven, SQ88(i), (int)((opp>>i)&1) );
+    }
+}
+
+// Pawn captures, then one or two squares ahead, as GNM's PAWN section
+static void bb_pawn( mc_engine *mc, byte from, bitboard own, bitboard opp )
+{
+    byte moven, to;
+    for( moven=6; moven>=5; moven-- )
+    {
+        to = from + MOVEX[moven];
+        if( !(to&0x88) && (opp&BIT(to)) )
+            bb_offer( mc, moven, to, 1 );
+    }
+    to = from;
+    do
+    {
+        to += MOVEX[4];
+        if( (to&0x88) || ((own|opp)&BIT(to)) )
+            break;
+        if( bb_offer( mc, 4, to, 0 ) )
+            break;
+    } while( (to&0xF0) == 0x20 );   // double move from 2nd rank
+}
+
+static void gnm_bitboard( mc_engine *mc )
+{
+    bitboard own=0, opp=0;
+    byte from, moven;
+    int piece;
+
+    // Occupancy of both sides; MOVE and UMOVE (via JANUS and CHKCHK)
+    //  always restore the board before we continue, so these hold
+    for( piece=0; piece<16; piece++ )
+    {
+        if( !(ZP(BOARD+piece)&0x88) )
+            own |= BIT( ZP(BOARD+piece) );
+        if( !(ZP(BK+piece)&0x88) )
+            opp |= BIT( ZP(BK+piece) );
+    }
+
+    for( piece=0x0F; piece>=0; piece-- )
+    {
+        from = ZP(BOARD+piece);
+        if( from & 0x88 )
+            continue;   // captured
+        ZP(PIECE) = (byte)piece;
+        if( piece >= 8 )
+            bb_pawn( mc, from, own, opp );
+        else if( piece >= 6 )
+        {
+            for( moven=0x10; moven>0x08; moven-- )
+                bb_step( mc, from, moven, own, opp );
+        }
+        else if( piece >= 4 )
+        {
+            for( moven=0x08; moven>0x04; moven-- )
+                bb_line( mc, from, moven, own, opp );
+        }
+        else if( piece >= 2 )
+        {
+            for( moven=0x04; moven>0x00; moven-- )
+                bb_line( mc, from, moven, own, opp );
+        }
+        else if( piece == 1 )
+        {
+            for( moven=0x08; moven>0x00; moven-- )
+                bb_line( mc, from, moven, own, opp );
+        }
+        else
+        {
+            for( moven=0x08; moven>0x00; moven-- )
+                bb_step( mc, from, moven, own, opp );
+        }
+    }
+
+    // Leave things as GNM does
+    ZP(PIECE)  = 0xFF;
+    ZP(MOVEN)  = 0x00;
+    ZP(SQUARE) = ZP(BOARD);
+}
+
+// Moves offered to JANUS, in order
+#define MAX_GEN     256
+struct gen_list
+{
+    int  n;
+    byte piece  [MAX_GEN];
+    byte square [MAX_GEN];
+    byte capture[MAX_GEN];
+};
+
+static void gen_record( mc_engine *mc )
+{
+    gen_list *list = mc->record;
+    if( list->n < MAX_GEN )
+    {
+        list->piece  [list->n] = ZP(PIECE);
+        list->square [list->n] = ZP(SQUARE);
+        list->capture[list->n] = mc->reg_v;
+    }
+    list->n++;
+}
+
+// List the moves of both generators for this position and report any
+//  difference; GNM then goes on to generate them for real
+static void gnm_compare( mc_engine *mc )
+{
+    gen_list emulated, bitboards;
+    int i, n;
+    emulated.n = bitboards.n = 0;
+    mc->generator = MC_GEN_6502;
+    mc->record    = &emulated;
+    GNM( mc );
+    mc->record    = &bitboards;
+    gnm_bitboard( mc );
+    mc->record    = NULL;
+    mc->generator = MC_GEN_COMPARE;
+
+    n = emulated.n < MAX_GEN ? emulated.n : MAX_GEN;
+    if( emulated.n != bitboards.n ||
+        memcmp( emulated.piece,   bitboards.piece,   n ) ||
+        memcmp( emulated.square,  bitboards.square,  n ) ||
+        memcmp( emulated.capture, bitboards.capture, n ) )
+    {
+        mc->mismatches++;
+        fprintf( stderr, "Move generators disagree, state=%02x board",
+                                                            ZP(STATE) );
+        for( i=0; i<32; i++ )
+            fprintf( stderr, " %02x", ZP(BOARD+i) );
+        fprintf( stderr, "\n" );
+    }
+}
+
+
+//**********************************************************************
+//*
+//*  Part 9
+//*  ------
+//*  Perft, counts the positions reachable in a given number of moves
+//*  using the engine's own move generation (GNM or the bitboard
+//*  generator, with CMOVE's check test) and MOVE, REVERSE and UMOVE.
+//*  Microchess knows nothing of castling, en passant or promotion, so
+//*  the counts are its own, not the standard ones, but they show any
+//*  change made to move generation and measure its speed.
+//**********************************************************************
+
+struct perft
+{
+    int depth;                  // moves still to make below this one
+    int ply;                    // moves made so far
+    unsigned long long nodes;   // positions counted
+    mc_divide_fn divide;        // per root move report, if wanted
+    void *ctx;
+};
+
+// Seconds since some fixed time
+static double seconds( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return( ts.tv_sec + ts.tv_nsec*1e-9 );
+}
+
+// JANUS in STATE 0 while counting, a move has been generated
+static void perft_visit( mc_engine *mc )
+{
+    perft *p = mc->perft;
+    unsigned long long before = p->nodes;
+    mc_move move;
+
+    if( p->depth <= 1 )
+        p->nodes++;
+    else
+    {
+        move.from = ZP(BOARD+ZP(PIECE));
+        MOVE( mc );                 // make the move
+        REVERSE( mc );              // then all the replies
+        p->depth--;
+        p->ply++;
+        GNM( mc );
+        p->ply--;
+        p->depth++;
+        REVERSE( mc );
+        UMOVE( mc );                // restores PIECE, SQUARE, MOVEN
+    }
+    if( p->ply==0 && p->divide )
+    {
+        move.piece = ZP(PIECE);
+        move.from  = ZP(BOARD+ZP(PIECE));
+        move.to    = ZP(SQUARE);
+        move.value = 0;
+        p->divide( p->ctx, &move, p->nodes-before );
+    }
+}
+
+// Count the positions "depth" moves deep, the computer moving first.
+//  With "legal" moves that leave the king in check are not counted
+//  (as CMOVE's check test), otherwise the king may be captured
+unsigned long long mc_perft( mc_engine *mc, int depth, int legal,
+                                        mc_divide_fn divide, void *ctx )
+{
+    perft p;
+    mc_stats stats = mc->stats;     // keep the counters of the last GO
+    byte state  = ZP(STATE);
+    byte level1 = mc->level1;
+
+    if( depth <= 0 )
+        return( 1 );
+    p.depth  = depth;
+    p.ply    = 0;
+    p.nodes  = 0;
+    p.divide = divide;
+    p.ctx    = ctx;
+    reset_stacks( mc );
+    mc->perft  = &p;
+    mc->level1 = legal ? 8 : 0;     // STATE 0 < level1, so check tested
+    ZP(STATE)  = 0;
+    GNM( mc );
+    ZP(STATE)  = state;
+    mc->level1 = level1;
+    mc->perft  = NULL;
+    mc->stats  = stats;
+    return( p.nodes );
+}
+
+// Console "div" command, one line per root move
+static void console_divide( void *ctx, const mc_move *move,
+                                                unsigned long long nodes )
+{
+    mc_engine *mc = (mc_engine *)ctx;
+    char text[5];
+    mc_move_text( mc, move, text );
+    out_printf( mc, "%s %llu\n", text, nodes );
+}
+
+// Console "perft" and "div" commands
+static void console_perft( mc_engine *mc, int depth, int bool_divide )
+{
+    double start = seconds(), elapsed;
+    unsigned long long nodes;
+    nodes = mc_perft( mc, depth, 1, bool_divide ? console_divide : NULL, mc );
+    elapsed = seconds() - start;
+    out_printf( mc, "Perft %d: %llu positions in %.3f seconds", depth, nodes,
+                                                                elapsed );
+    if( elapsed > 0 )
+        out_printf( mc, " (%.0f positions/second)", nodes/elapsed );
+    out_printf( mc, "\n" );
+}
+
+
+//**********************************************************************
+//*
+//*  Part 10
+//*  -------
+//*  Microbenchmarks, time single routines of the search on the current
+//*  board. The routines share their arguments and results through zero
+//*  page, so each case sets PIECE, SQUARE, MOVEN and STATE itself before
+//*  every call, and the whole engine is restored afterwards. Output is
+//*  discarded, so POUT measures the board scan, not the terminal
+//**********************************************************************
+
+typedef struct micro_case
+{
+    const char *name;
+    void (*prepare)( mc_engine *mc );           // once, not timed
+    void (*op)( mc_engine *mc, unsigned long k );
+} micro_case;
+
+// One step of piece k&0F in direction 1-8, the STATE decides whether
+//  CMOVE also tests for check
+static void micro_step( mc_engine *mc, unsigned long k, byte state )
+{
+    byte piece = (byte)(k & 0x0f);
+    ZP(PIECE)  = piece;
+    ZP(SQUARE) = ZP(BOARD+piece);
+    ZP(MOVEN)  = (byte)(1 + ((k>>4) & 7));
+    ZP(STATE)  = state;
+    CMOVE( mc );
+}
+
+static void micro_cmove( mc_engine *mc, unsigned long k )
+{
+    micro_step( mc, k, 0x0C );  // STATE C, no check test
+}
+
+static void micro_chkchk( mc_engine *mc, unsigned long k )
+{
+    micro_step( mc, k, 0x00 );  // STATE 0 < level1, check tested
+}
+
+// Pawn k&07 one square ahead (or the king standing still), and back
+static void micro_move( mc_engine *mc, unsigned long k )
+{
+    byte piece = (byte)(8 + (k & 7));
+    byte to    = ZP(BOARD+piece) + 0x10;
+    if( to & 0x88 )
+    {
+        piece = 0;
+        to    = ZP(BOARD);
+    }
+    ZP(PIECE)  = piece;
+    ZP(SQUARE) = to;
+    MOVE( mc );
+    UMOVE( mc );
+}
+
+static void micro_reverse( mc_engine *mc, unsigned long k )
+{
+    (void)k;
+    REVERSE( mc );
+}
+
+static void micro_gnm( mc_engine *mc, unsigned long k )
+{
+    (void)k;
+    ZP(STATE) = 0x0C;           // as GO's first pass, every move counted
+    GNMZ( mc );
+}
+
+static void micro_stratgy( mc_engine *mc, unsigned long k )
+{
+    (void)k;
+    ZP(BESTV) = 0;              // same path through CKMATE every time
+    STRATGY( mc );
+}
+
+static void micro_pout( mc_engine *mc, unsigned long k )
+{
+    (void)k;
+    mc->bool_console = 1;       // draw the board, every character of it
+    mc->board_length = -1;      //  discarded by smart_out()
+    mc->discard = INT_MAX;
+    POUT( mc );
+    mc->bool_console = 0;
+}
+
+static void micro_level1( mc_engine *mc )
+{
+    mc->level1 = 8;
+}
+
+static void micro_counters( mc_engine *mc )
+{
+    ZP(STATE) = 0x0C;           // counters of a real position to evaluate
+    GNMZ( mc );
+    ZP(STATE) = 0x04;
+    ZP(PIECE) = 0x0f;
+    ZP(SQUARE)= ZP(BOARD+0x0f);
+}
+
+static const micro_case micro_cases[] =
+{
+    { "CMOVE",          NULL,           micro_cmove     },
+    { "CMOVE+CHKCHK",   micro_level1,   micro_chkchk    },
+    { "MOVE+UMOVE",     NULL,           micro_move      },
+    { "REVERSE",        NULL,           micro_reverse   },
+    { "GNM",            NULL,           micro_gnm       },
+    { "STRATGY",        micro_counters, micro_stratgy   },
+    { "POUT",           NULL,           micro_pout      }
+};
+
+#define MICRO_CASES     ((int)(sizeof(micro_cases)/sizeof(micro_cases[0])))
+#define MICRO_SAMPLE    0.002   // seconds a sample should take at least
+
+// Time "ops" calls of a case, in seconds
+static double micro_run( mc_engine *mc, const micro_case *c,
+                                                        unsigned long ops )
+{
+    unsigned long k;
+    double start = seconds();
+    for( k=0; k<ops; k++ )
+        c->op( mc, k );
+    return( seconds() - start );
+}
+
+// Time case "which" (from 0) on the current board, "samples" samples of
+//  as many calls as fill MICRO_SAMPLE. Returns MC_ERROR past the last
+int mc_microbench( mc_engine *mc, int which, int samples, mc_timing *timing )
+{
+    const micro_case *c;
+    mc_engine *saved;
+    unsigned long ops = 16;
+    double ns, sum=0, sum2=0, min=0;
+    int i;
+
+    if( which < 0 || which >= MICRO_CASES || samples < 1 )
+        return( MC_ERROR );
+    saved = (mc_engine *)malloc( sizeof(mc_engine) );
+    if( saved == NULL )
+        return( MC_ERROR );
+    *saved = *mc;
+    c = &micro_cases[which];
+    mc->bool_console = 0;
+    mc->threads = 1;
+    reset_stacks( mc );
+    if( c->prepare )
+        c->prepare( mc );
+
+    // Warm up, finding how many calls fill a sample
+    while( micro_run(mc,c,ops) < MICRO_SAMPLE && ops < 0x40000000 )
+        ops *= 2;
+    for( i=0; i<samples; i++ )
+    {
+        ns = micro_run( mc, c, ops ) * 1e9 / ops;
+        sum  += ns;
+        sum2 += ns*ns;
+        if( i==0 || ns<min )
+            min = ns;
+    }
+    *mc = *saved;
+    free( saved );
+
+    timing->name      = c->name;
+    timing->ops       = ops;
+    timing->samples   = samples;
+    timing->ns_per_op = sum / samples;
+    timing->ns_stddev = samples>1 ? sqrt( (sum2 - sum*sum/samples) /
+                                                        (samples-1) ) : 0;
+    timing->ns_min    = min;
+    return( MC_OK );
+}
+
+
+//**********************************************************************
+//*
+//*  Part 11
+//*  -------
+//*  Search counters. Each engine counts what its last GO did: the moves
+//*  JANUS analysed in each STATE, the calls to the routines doing the
+//*  work, and the time taken. A counter is one increment in the routine
+//*  concerned (see STAT), so they are always on unless the library is
+//*  built with MC_NO_STATS
+//**********************************************************************
+
+// Add the counters of a parallel search worker to the engine's
+static void stats_add( mc_stats *sum, const mc_stats *stats )
+{
+    int i;
+    sum->janus   += stats->janus;
+    for( i=0; i<256; i++ )
+        sum->janus_state[i] += stats->janus_state[i];
+    sum->cmove   += stats->cmove;
+    sum->chkchk  += stats->chkchk;
+    sum->gnm     += stats->gnm;
+    sum->move    += stats->move;
+    sum->reverse += stats->reverse;
+    sum->genrm   += stats->genrm;
+    sum->hash_probes += stats->hash_probes;
+    sum->hash_hits   += stats->hash_hits;
+}
+
+// Counters for the search made by the last GO
+void mc_get_stats( mc_engine *mc, mc_stats *stats )
+{
+    *stats = mc->stats;
+}
+
+// Console "stats" command
+static void console_stats( mc_engine *mc )
+{
+    static const struct { byte state; const char *what; } states[] =
+    {
+        { 0x0C, "opponent's moves now" },
+        { 0x04, "program's moves" },
+        { 0x00, "opponent's replies" },
+        { 0x08, "program's continuations" },
+        { 0xF9, "check tests (CHKCHK)" }
+    };
+    mc_stats *st = &mc->stats;
+    int i;
+
+    out_printf( mc, "Last search, %.3f seconds\n", st->seconds );
+    out_printf( mc, "JANUS          %12llu\n", st->janus );
+    for( i=0; i<(int)(sizeof(states)/sizeof(states[0])); i++ )
+        out_printf( mc, "  STATE %02X     %12llu  %s\n", states[i].state,
+                            st->janus_state[states[i].state], states[i].what );
+    for( i=0xFF; i>=0x80; i-- )
+    {
+        if( i != 0xF9 && st->janus_state[i] )
+            out_printf( mc, "  STATE %02X     %12llu  capture tree\n", i,
+                                                        st->janus_state[i] );
+    }
+    out_printf( mc, "CMOVE          %12llu\n", st->cmove );
+    out_printf( mc, "CHKCHK         %12llu\n", st->chkchk );
+    out_printf( mc, "GNM            %12llu\n", st->gnm );
+    out_printf( mc, "MOVE/UMOVE     %12llu\n", st->move );
+    out_printf( mc, "REVERSE        %12llu\n", st->reverse );
+    out_printf( mc, "GENRM (TREE)   %12llu\n", st->genrm );
+    out_printf( mc, "Hash probes    %12llu\n", st->hash_probes );
+    out_printf( mc, "Hash hits      %12llu\n", st->hash_hits );
+}
+
+
+//**********************************************************************
+//*
+//*  Part 12
+//*  -------
+//*  Check detection. CHKCHK used to make the trial move, reverse the
+//*  board and generate every reply just to see whether one of them
+//*  lands on the king. Instead look outward from the king square for a
+//*  piece that could make such a reply: the first piece along each of
+//*  the eight MOVEX lines (a king or pawn only if adjacent) and knights a
+//*  knight's move away. The trial move isn't made, its from square reads
+//*  as empty and its to square as holding PIECE
+//**********************************************************************
+
+// The piece on a square once PIECE has moved from "from" to "to"
+static byte check_find( mc_engine *mc, byte square, byte from, byte to )
+{
+    if( square == to )
+        return( ZP(PIECE) );
+    if( square == from )
+        return( EMPTY );
+    return( mailbox_find( mc, square ) );
+}
+
+// Could one of the opponent's replies to PIECE moving to SQUARE capture
+//  the king ?
+static int king_attacked( mc_engine *mc )
+{
+    byte from = ZP(BOARD+ZP(PIECE));
+    byte to   = ZP(SQUARE);
+    byte king = ZP(PIECE) ? ZP(BOARD) : to;
+    byte moven, square, piece;
+    int step;
+
+    if( king & 0x88 )
+        return( 0 );                // no king to capture
+    for( moven=1; moven<=8; moven++ )
+    {
+        square = king;
+        for( step=1; ; step++ )
+        {
+            square += MOVEX[moven];
+            if( square & 0x88 )
+                break;
+            piece = check_find( mc, square, from, to );
+            if( piece == EMPTY )
+                continue;
+            if( piece < 0x10 )
+                break;              // blocked by our own piece
+            piece -= 0x10;
+            if( piece == 1 ||                                  // QUEEN
+                (piece == 0 && step == 1) ||                   // KING
+                ((piece == 2 || piece == 3) && moven <= 4) ||  // ROOK
+                ((piece == 4 || piece == 5) && moven >= 5) ||  // BISHOP
+                (piece >= 8 && step == 1 &&                    // PAWN, ITS
+                                (moven == 5 || moven == 6)) )  //  MOVEN 6,5
+                return( 1 );
+            break;
+        }
+    }
+    for( moven=9; moven<=16; moven++ )
+    {
+        square = king + MOVEX[moven];
+        if( !(square & 0x88) )
+        {
+            piece = check_find( mc, square, from, to );
+            if( piece == 0x16 || piece == 0x17 )               // KNIGHT
+                return( 1 );
+        }
+    }
+    return( 0 );
+}
+
+// CHKCHK's test, INCHEK 0 if the trial move leaves the king in check,
+//  otherwise F9, as generating the replies would leave it
+static void check_attack( mc_engine *mc )
+{
+    ZP(INCHEK) = king_attacked( mc ) ? 0x00 : 0xF9;
+}
+
+// MC_GEN_COMPARE, the replies have been generated, does the attack test
+//  agree ?
+static void check_compare( mc_engine *mc )
+{
+    int i;
+    if( (ZP(INCHEK) == 0) != king_attacked( mc ) )
+    {
+        mc->mismatches++;
+        fprintf( stderr, "Check tests disagree, piece=%02x square=%02x"
+                        " board", ZP(PIECE), ZP(SQUARE) );
+        for( i=0; i<32; i++ )
+            fprintf( stderr, " %02x", ZP(BOARD+i) );
+        fprintf( stderr, "\n" );
+    }
+}
+
+
+//**********************************************************************
+//*
+//*  Part 13
+//*  -------
+//*  Zobrist keys and a transposition table. Two kinds of result are
+//*  cached, both completely determined by the position they start from:
+//*  the counters ON4 leaves for STRATGY after generating the replies and
+//*  continuations to a move, and the best captures the capture tree
+//*  (TREE/GENRM) finds below a capture. The tree only ever raises its
+//*  BCAP/WCAP counters to the largest value seen, so a cached subtree is
+//*  merged in by taking the larger value, in any order. (The CHKCHK
+//*  verdict isn't cached, looking for an attacker, Part 12, is cheaper
+//*  than a table probe.) Entries are four 64 bit words, the first the key
+//*  exclusive or'ed with the other three, so parallel search workers can
+//*  share the table without locks; a torn entry just fails to match
+//**********************************************************************
+
+#define HASH_WAYS       2       // entries per bucket, 64 bytes
+#define HASH_COUNTERS   17      // COUNT to WMAXP, as cleared by GNMZ
+
+typedef struct hash_entry
+{
+    unsigned long long check;   // key ^ data[0] ^ data[1] ^ data[2]
+    unsigned long long data[3]; // depth, age then the counters
+} hash_entry;
+
+struct hash_table
+{
+    hash_entry *entry;
+    unsigned long long mask;    // buckets-1
+    byte age;                   // GOs made, entries from older GOs are
+};                              //  replaced first
+
+// Key contribution of each piece on each square
+static unsigned long long zobrist[32][128];
+static pthread_once_t zobrist_once = PTHREAD_ONCE_INIT;
+
+#ifdef __GNUC__
+#define HASH_LOAD(word)         __atomic_load_n( &(word), __ATOMIC_RELAXED )
+#define HASH_STORE(word,value)  __atomic_store_n( &(word), (value), \
+                                                        __ATOMIC_RELAXED )
+#else
+#define HASH_LOAD(word)         (word)
+#define HASH_STORE(word,value)  ((word) = (value))
+#endif
+
+// Fixed keys, so a table could be compared between runs
+static void zobrist_fill( void )
+{
+    unsigned long long x = 0x4d6963726f636865ULL;   // splitmix64
+    int piece, square;
+    for( piece=0; piece<32; piece++ )
+    {
+        for( square=0; square<128; square++ )
+        {
+            unsigned long long z = (x += 0x9e3779b97f4a7c15ULL);
+            z = (z ^ (z>>30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z>>27)) * 0x94d049bb133111ebULL;
+            zobrist[piece][square] = (square&0x88) ? 0 : z ^ (z>>31);
+        }
+    }
+}
+
+static void zobrist_init( void )
+{
+    pthread_once( &zobrist_once, zobrist_fill );
+}
+
+// Key of one piece on one square, as the board is and reversed (where
+//  it is the other side's piece on the mirror image square). Pieces off
+//  the board (0xCC) don't count
+#define ZOBRIST(piece,square)   zobrist[(piece)&0x1f][(square)&0x7f]
+#define RZOBRIST(piece,square)  zobrist[((piece)^0x10)&0x1f][((square)^0x77)&0x7f]
+#define ON_BOARD(square)        (!((square)&0x88))
+
+// Keys from scratch, with the mailbox
+static void zobrist_build( mc_engine *mc )
+{
+    int i;
+    byte square;
+    zobrist_init();
+    mc->key = mc->rkey = 0;
+    for( i=0; i<32; i++ )
+    {
+        square = ZP(BOARD+i);
+        if( ON_BOARD(square) )
+        {
+            mc->key  ^= ZOBRIST(i,square);
+            mc->rkey ^= RZOBRIST(i,square);
+        }
+    }
+}
+
+// MOVE and UMOVE, piece goes from one square to another (or back)
+//  taking "captured" (or putting it back) unless that is EMPTY
+static void zobrist_move( mc_engine *mc, byte piece, byte from, byte to,
+                                                            byte captured )
+{
+    if( ON_BOARD(from) )
+    {
+        mc->key  ^= ZOBRIST(piece,from);
+        mc->rkey ^= RZOBRIST(piece,from);
+    }
+    if( ON_BOARD(to) )
+    {
+        mc->key  ^= ZOBRIST(piece,to);
+        mc->rkey ^= RZOBRIST(piece,to);
+        if( captured != EMPTY )
+        {
+            mc->key  ^= ZOBRIST(captured,to);
+            mc->rkey ^= RZOBRIST(captured,to);
+        }
+    }
+}
+
+// Key of the position after PIECE moves to SQUARE, for one kind of
+//  result ("kind", plus the STATE and levels it depends on)
+static unsigned long long hash_key( mc_engine *mc, unsigned int kind )
+{
+    byte piece    = ZP(PIECE);
+    byte from     = ZP(BOARD+piece);
+    byte to       = ZP(SQUARE);
+    byte captured = mailbox_find( mc, to );
+    unsigned long long key = mc->key;
+    if( ON_BOARD(from) )
+        key ^= ZOBRIST(piece,from);
+    if( ON_BOARD(to) )
+    {
+        key ^= ZOBRIST(piece,to);
+        if( captured != EMPTY )
+            key ^= ZOBRIST(captured,to);
+    }
+    return( key ^ (kind * 0x9e3779b97f4a7c15ULL) );
+}
+
+// Look a key up, copying its "n" result bytes if found
+static int hash_probe( mc_engine *mc, unsigned long long key, byte *result,
+                                                                    int n )
+{
+    hash_entry *e = &mc->hash->entry[ (key & mc->hash->mask) * HASH_WAYS ];
+    unsigned long long data[3];
+    int i;
+
+    STAT( hash_probes );
+    for( i=0; i<HASH_WAYS; i++, e++ )
+    {
+        data[0] = HASH_LOAD( e->data[0] );
+        data[1] = HASH_LOAD( e->data[1] );
+        data[2] = HASH_LOAD( e->data[2] );
+        if( (HASH_LOAD(e->check) ^ data[0] ^ data[1] ^ data[2]) == key )
+        {
+            STAT( hash_hits );
+            memcpy( result, (byte *)data+2, n );
+            return( 1 );
+        }
+    }
+    return( 0 );
+}
+
+// Save a result, "depth" is how much work it would take to make again.
+//  The first entry of a bucket keeps the deepest result of the current
+//  GO, the second always takes the new one
+static void hash_store( mc_engine *mc, unsigned long long key,
+                                    const byte *result, int n, byte depth )
+{
+    hash_table *table = mc->hash;
+    hash_entry *e = &table->entry[ (key & table->mask) * HASH_WAYS ];
+    unsigned long long data[3] = { 0, 0, 0 }, old;
+    byte *bytes = (byte *)data;
+
+    old = HASH_LOAD( e->data[0] );
+    if( (byte)(old>>8) == table->age && (byte)old > depth )
+        e++;
+    bytes[0] = depth;
+    bytes[1] = table->age;
+    memcpy( bytes+2, result, n );
+    HASH_STORE( e->data[0], data[0] );
+    HASH_STORE( e->data[1], data[1] );
+    HASH_STORE( e->data[2], data[2] );
+    HASH_STORE( e->check, key ^ data[0] ^ data[1] ^ data[2] );
+}
+
+// GO, a new search, entries of earlier ones are replaced first
+static void hash_age( mc_engine *mc )
+{
+    if( mc->hash )
+        mc->hash->age++;
+}
+
+#define HASH_ON4        0x10000     // kinds, or'ed with STATE and levels
+#define HASH_GENRM      0x20000
+
+static unsigned int hash_on4_kind( mc_engine *mc )
+{
+    return( HASH_ON4 | mc->level1<<8 | mc->level2 );
+}
+
+// ON4, if the replies and continuations to PIECE moving to SQUARE are
+//  known, set the counters (and STATE) as generating them would
+static int hash_on4( mc_engine *mc )
+{
+    if( !mc->hash || mc->bool_show_move_generation
+                  || mc->bool_show_move_evaluation )
+        return( 0 );
+    if( !hash_probe( mc, hash_key(mc,hash_on4_kind(mc)),
+                                        &ZP(COUNT), HASH_COUNTERS ) )
+        return( 0 );
+    ZP(STATE) = 0x08;
+    return( 1 );
+}
+
+// ON4, the counters have been generated
+static void hash_on4_store( mc_engine *mc )
+{
+    if( mc->hash && !mc->bool_show_move_generation
+                 && !mc->bool_show_move_evaluation )
+        hash_store( mc, hash_key(mc,hash_on4_kind(mc)), &ZP(COUNT),
+                                                    HASH_COUNTERS, 0xff );
+}
+
+// TREE, in place of GENRM at STATE FF to level2+1. The capture tree
+//  below PIECE taking on SQUARE raises the counters BCAP0+STATE down to
+//  BCAP0+level2+1 to the best captures it finds; look up (or find) the
+//  best values for the subtree alone and raise the counters to them
+static void hash_genrm( mc_engine *mc )
+{
+    byte state = ZP(STATE);
+    byte level = mc->level2;
+    byte saved[4], found[4];
+    unsigned long long key;
+    int i, n = state - level;   // counters the subtree can change
+
+    if( mc->bool_show_move_generation || mc->bool_show_move_evaluation
+                                      || n < 1 || n > 4 )
+    {
+        JSR( GENRM );
+        return;
+    }
+    key = hash_key( mc, HASH_GENRM | state<<8 | level );
+    if( !hash_probe( mc, key, found, n ) )
+    {
+        for( i=0; i<n; i++ )
+        {
+            saved[i] = ZP(BCAP0+state-i);
+            ZP(BCAP0+state-i) = 0;
+        }
+        JSR( GENRM );
+        for( i=0; i<n; i++ )
+        {
+            found[i] = ZP(BCAP0+state-i);
+            ZP(BCAP0+state-i) = saved[i];
+        }
+        hash_store( mc, key, found, n, (byte)n );
+    }
+    for( i=0; i<n; i++ )
+    {
+        if( found[i] >= ZP(BCAP0+state-i) )
+            ZP(BCAP0+state-i) = found[i];
+    }
+}
+
+// Transposition table size in megabytes, 0 for none. Returns MC_ERROR if
+//  there isn't the memory (and leaves the engine without a table)
+int mc_set_hash( mc_engine *mc, int megabytes )
+{
+    unsigned long long buckets = 1;
+    hash_table *table;
+
+    if( mc->hash )
+    {
+        free( mc->hash->entry );
+        free( mc->hash );
+        mc->hash = NULL;
+    }
+    if( megabytes <= 0 )
+        return( megabytes==0 ? MC_OK : MC_ERROR );
+    while( buckets*2*HASH_WAYS*sizeof(hash_entry) <=
+                                        (unsigned long long)megabytes<<20 )
+        buckets *= 2;
+    table = (hash_table *)malloc( sizeof(hash_table) );
+    if( table == NULL )
+        return( MC_ERROR );
+    table->entry = (hash_entry *)calloc( buckets*HASH_WAYS,
+                                                    sizeof(hash_entry) );
+    if( table->entry == NULL )
+    {
+        free( table );
+        return( MC_ERROR );
+    }
+    table->mask = buckets-1;
+    table->age  = 0;
+    mc->hash    = table;
+    return( MC_OK );
+}
+
+// Forget everything in the transposition table
+void mc_clear_hash( mc_engine *mc )
+{
+    if( mc->hash )
+        memset( mc->hash->entry, 0, (mc->hash->mask+1) * HASH_WAYS *
+                                                    sizeof(hash_entry) );
+}
+
+
+//**********************************************************************
+//*
+//*  Part 14
+//*  -------
+//*  Engine protocol, a line oriented UCI style interface for game servers
+//*  and tournament managers (uci, isready, ucinewgame, setoption,
+//*  position startpos or fen, go with or without a clock, stop, quit).
+//*  Moves are absolute algebraic, eg "e2e4", whichever side the
+//*  computer plays. There is no board display, the
+//*  engine runs with bool_console clear, so nothing is drawn or discarded.
+//*  GO runs on its own thread so isready is answered during a search; a
+//*  search can't be cut short, so stop just waits for it to finish
+//**********************************************************************
+
+#define PROTOCOL_LINE   16384
+
+typedef struct protocol
+{
+    mc_engine *mc;
+    pthread_t thread;
+    pthread_mutex_t lock;       // one thread writes to stdout at a time
+    int searching;              // thread started, not yet joined
+    int infinite;               // "go infinite", bestmove waits for stop
+    int to_move;                // computer to move, the search plays its
+                                //  move so "position" must come again
+    char bestmove[5];
+    char game[PROTOCOL_LINE];   // position on the board, eg "startpos
+} protocol;                     //  e2e4 e7e5", "" if unknown
+
+// Write one line of the protocol
+static void protocol_out( protocol *p, const char *format, ... )
+{
+    va_list args;
+    pthread_mutex_lock( &p->lock );
+    va_start( args, format );
+    vprintf( format, args );
+    va_end( args );
+    fputc( '\n', stdout );
+    fflush( stdout );
+    pthread_mutex_unlock( &p->lock );
+}
+
+// Search thread, play the best move and report it
+static void *protocol_search( void *arg )
+{
+    protocol *p = (protocol *)arg;
+    mc_engine *mc = p->mc;
+    mc_move best;
+    size_t len;
+
+    p->to_move = 0;
+    if( MC_OK != mc_go(mc,&best) )
+        strcpy( p->bestmove, "0000" );  // UCI null move, nothing to play
+    else
+    {
+        mc_move_text( mc, &best, p->bestmove );
+        len = strlen( p->game );        // the board now has the move
+        if( len && len+6 < sizeof(p->game) )
+            sprintf( p->game+len, " %s", p->bestmove );
+        else
+            p->game[0] = '\0';
+    }
+    if( mc->clock_on )
+        protocol_out( p, "info string level %d", mc_get_level(mc) );
+    protocol_out( p, "info nodes %llu time %.0f", mc->stats.janus,
+                                                mc->stats.seconds*1000 );
+    if( !p->infinite )
+        protocol_out( p, "bestmove %s", p->bestmove );
+    return( NULL );
+}
+
+// Wait for a search to finish, giving its move if it was held back
+static void protocol_stop( protocol *p )
+{
+    if( !p->searching )
+        return;
+    pthread_join( p->thread, NULL );
+    p->searching = 0;
+    if( p->infinite )
+        protocol_out( p, "bestmove %s", p->bestmove );
+    p->infinite = 0;
+}
+
+// Play one move given in absolute algebraic notation. Microchess knows
+//  nothing of castling, so a king moving two files takes its rook along
+//  (as the console's "oo" and "ooo"), and a promotion is ignored
+static int protocol_move( mc_engine *mc, const char *text )
+{
+    unsigned char from, to, rook_from, rook_to;
+    char rook[4];
+    byte piece, other;
+    size_t len = strlen( text );
+
+    if( (len!=4 && len!=5) || MC_OK != mc_parse_move(mc,text,&from,&to) )
+        return( MC_ERROR );
+    piece = mailbox_find( mc, from );
+    if( MC_OK != mc_apply_move(mc,from,to) )
+        return( MC_ERROR );
+    if( (piece&0x0f)==0 && text[1]==text[3] && (text[1]=='1'||text[1]=='8')
+                        && text[0]=='e' && (text[2]=='g'||text[2]=='c') )
+    {
+        rook[0] = text[2]=='g' ? 'h' : 'a';
+        rook[1] = text[1];
+        rook[2] = text[2]=='g' ? 'f' : 'd';
+        rook[3] = text[1];
+        mc_parse_move( mc, rook, &rook_from, &rook_to );
+        other = mailbox_find( mc, rook_from );
+        if( other != EMPTY && (other&0x10) == (piece&0x10) &&
+                            ((other&0x0f)==2 || (other&0x0f)==3) )
+            mc_apply_move( mc, rook_from, rook_to );
+    }
+    return( MC_OK );
+}
+
+// "position startpos|fen <fen> [moves ...]". If the position is the game
+//  on the board plus some moves, just play them, so the opening book
+//  carries on as it would at the console. Either way the computer is left
+//  to move
+static void protocol_position( protocol *p, char *args )
+{
+    mc_engine *mc = p->mc;
+    char game[PROTOCOL_LINE], *text, side='w';
+    unsigned char squares[MC_PIECES];
+    size_t len, base, skip;
+    int moves=0, white;
+
+    text = strtok( args, " \t" );
+    if( text && 0==strcmp(text,"startpos") )
+    {
+        strcpy( game, "startpos" );
+        text = strtok( NULL, " \t" );
+    }
+    else if( text && 0==strcmp(text,"fen") )
+    {
+        strcpy( game, "fen" );
+        for( text=strtok(NULL," \t"); text && 0!=strcmp(text,"moves");
+                                                text=strtok(NULL," \t") )
+        {
+            len = strlen( game );
+            if( len+strlen(text)+2 > sizeof(game) )
+                break;
+            sprintf( game+len, " %s", text );
+        }
+        sscanf( game, "fen %*s %c", &side );
+    }
+    else
+    {
+        protocol_out( p, "info string unknown position" );
+        return;
+    }
+    base = strlen( game );
+    if( text && 0==strcmp(text,"moves") )
+    {
+        for( text=strtok(NULL," \t"); text; text=strtok(NULL," \t") )
+        {
+            len = strlen( game );
+            if( len+strlen(text)+2 > sizeof(game) )
+                break;
+            sprintf( game+len, " %s", text );
+            moves++;
+        }
+    }
+
+    // Same game, further on ?
+    len = strlen( p->game );
+    if( len && 0==strncmp(game,p->game,len) &&
+                                    (game[len]==' ' || game[len]=='\0') )
+        skip = len;
+    else
+    {
+        skip = base;
+        if( game[0] == 's' )
+            mc_new_game( mc, 1 );
+        else if( MC_OK != mc_set_fen(mc,game+4) )
+        {
+            protocol_out( p, "info string bad fen" );
+            p->game[0] = '\0';
+            p->to_move = 0;
+            return;
+        }
+    }
+    strcpy( p->game, game );
+    p->to_move = 1;
+    for( text=strtok(game+skip," "); text; text=strtok(NULL," ") )
+    {
+        if( MC_OK != protocol_move(mc,text) )
+        {
+            protocol_out( p, "info string illegal move %s", text );
+            p->game[0] = '\0';
+            p->to_move = 0;
+            break;
+        }
+    }
+
+    // The book only follows games the computer played from the start
+    if( skip == base && moves > 0 )
+        mc_set_position( mc, squares, mc_get_position(mc,squares) );
+
+    // Computer to move
+    white = (side=='w') == ((moves&1) == 0);
+    if( white != (ZP(REV)==0) )
+        mc_reverse( mc );
+}
+
+// "go [wtime <ms>] [btime <ms>] [winc <ms>] [binc <ms>] [movestogo <n>]",
+//  the computer's clock chooses the level (Part 16) if it is given
+static void protocol_clock( protocol *p, char *args )
+{
+    mc_engine *mc = p->mc;
+    const char *time = ZP(REV)==0 ? "wtime" : "btime";
+    const char *inc  = ZP(REV)==0 ? "winc"  : "binc";
+    char *name, *value;
+    long remaining=-1, increment=0, moves=0;
+
+    for( name=strtok(args," \t"); name; name=strtok(NULL," \t") )
+    {
+        if( strcmp(name,time) && strcmp(name,inc)
+                              && strcmp(name,"movestogo") )
+            continue;
+        value = strtok( NULL, " \t" );
+        if( value == NULL )
+            break;
+        if( 0 == strcmp(name,time) )
+            remaining = atol( value );
+        else if( 0 == strcmp(name,inc) )
+            increment = atol( value );
+        else
+            moves = atol( value );
+    }
+    if( remaining < 0 )
+        mc_set_clock( mc, MC_CLOCK_OFF, 0, 0 );
+    else
+        mc_set_clock( mc, remaining/1000.0, increment/1000.0, (int)moves );
+}
+
+// "setoption name <name> value <value>"
+static void protocol_option( protocol *p, char *args )
+{
+    char *name, *value;
+    int n;
+
+    name  = strstr( args, "name " );
+    value = strstr( args, " value " );
+    if( name==NULL || value==NULL )
+        return;
+    *value = '\0';
+    name += 5;
+    n = atoi( value+7 );
+    if( 0 == strcasecmp(name,"Level") )
+        mc_set_level( p->mc, n );
+    else if( 0 == strcasecmp(name,"Threads") )
+        mc_set_threads( p->mc, n );
+    else if( 0 == strcasecmp(name,"Hash") )
+        mc_set_hash( p->mc, n );
+    else if( 0 == strcasecmp(name,"BookFile") )
+    {
+        if( MC_OK != mc_set_book( p->mc, value[7] ? value+7 : NULL ) )
+            protocol_out( p, "info string can't open book %s", value+7 );
+    }
+    else
+        protocol_out( p, "info string unknown option %s", name );
+}
+
+// Engine protocol on stdin/stdout, until "quit" or end of input
+int mc_protocol( mc_engine *mc )
+{
+    protocol *p;
+    char *line, *args;
+    size_t len;
+
+    p = (protocol *)calloc( 1, sizeof(protocol) );
+    line = (char *)malloc( PROTOCOL_LINE );
+    if( p==NULL || line==NULL )
+    {
+        free( p );
+        free( line );
+        return( 1 );
+    }
+    p->mc = mc;
+    pthread_mutex_init( &p->lock, NULL );
+    mc->bool_console = 0;
+    mc_new_game( mc, 1 );
+    strcpy( p->game, "startpos" );
+    p->to_move = 1;
+
+    while( NULL != fgets(line,PROTOCOL_LINE,stdin) )
+    {
+        len = strlen( line );
+        while( len && isspace((unsigned char)line[len-1]) )
+            line[--len] = '\0';
+        for( args=line; *args && !isspace((unsigned char)*args); args++ )
+            ;
+        if( *args )
+            *args++ = '\0';
+        if( 0 == strcmp(line,"uci") )
+        {
+            protocol_out( p, "id name MicroChess" );
+            protocol_out( p, "id author Peter Jennings, Bill Forster" );
+            protocol_out( p, "option name Level type spin default %d"
+                        " min %d max %d", MC_LEVEL_NORMAL,
+                        MC_LEVEL_SUPER_BLITZ, MC_LEVEL_NORMAL );
+            protocol_out( p, "option name Threads type spin default 1"
+                        " min 1 max %d", MC_MAX_THREADS );
+            protocol_out( p, "option name Hash type spin default %d"
+                        " min 0 max 4096", MC_HASH_DEFAULT );
+            protocol_out( p, "option name BookFile type string default" );
+            protocol_out( p, "uciok" );
+        }
+        else if( 0 == strcmp(line,"isready") )
+            protocol_out( p, "readyok" );
+        else if( 0 == strcmp(line,"stop") )
+            protocol_stop( p );
+        else if( 0 == strcmp(line,"quit") )
+            break;
+        else if( 0 == strcmp(line,"go") )
+        {
+            protocol_stop( p );
+            if( !p->to_move )
+            {
+                protocol_out( p, "info string no position to search" );
+                protocol_out( p, "bestmove 0000" );
+                continue;
+            }
+            p->infinite = NULL != strstr( args, "infinite" );
+            protocol_clock( p, args );
+            if( 0 == pthread_create(&p->thread,NULL,protocol_search,p) )
+                p->searching = 1;
+            else
+            {
+                p->infinite = 0;
+                protocol_search( p );
+            }
+        }
+        else
+        {
+            protocol_stop( p );     // the rest change the engine
+            if( 0 == strcmp(line,"ucinewgame") )
+            {
+                mc_clear_hash( mc );
+                mc_new_game( mc, 1 );
+                strcpy( p->game, "startpos" );
+                p->to_move = 1;
+            }
+            else if( 0 == strcmp(line,"position") )
+                protocol_position( p, args );
+            else if( 0 == strcmp(line,"setoption") )
+                protocol_option( p, args );
+        }
+    }
+    protocol_stop( p );
+    pthread_mutex_destroy( &p->lock );
+    free( line );
+    free( p );
+    return( 0 );
+}
+
+
+//**********************************************************************
+//*
+//*  Part 15
+//*  -------
+//*  Native fast path. CMOVE, JANUS, MOVE, UMOVE, REVERSE, STRATGY and
+//*  GNM written directly in C rather than as emulated 6502 code; no
+//*  registers are kept up to date inside them and no flags are worked
+//*  out only to be tested once. Each leaves the zero page, stacks and
+//*  mailbox exactly as its 6502 original does, and the registers too
+//*  where a caller may look at them (CMOVE's flags, say), so they can
+//*  stand in for the originals one by one. MC_NATIVE_COMPARE runs both
+//*  and reports any difference; MC_NATIVE_OFF is the emulation alone
+//**********************************************************************
+
+// RESET
+static void native_reset( mc_engine *mc )
+{
+    ZP(SQUARE) = ZP(BOARD+ZP(PIECE));
+}
+
+// CHKCHK, after CMOVE has found a legal looking to square
+static void chkchk_native( mc_engine *mc )
+{
+    byte state = ZP(STATE);
+    if( (state&0x80) || !((byte)(state-mc->level1)&0x80) )
+        ;                           // no check test at this depth
+    else if( mc->bool_show_move_generation ||
+             mc->generator == MC_GEN_COMPARE )
+    {
+        CHKCHK( mc );               // generate the replies
+        return;
+    }
+    else
+    {
+        STAT( chkchk );
+        check_attack( mc );
+        if( !(ZP(INCHEK)&0x80) )
+        {
+            mc->reg_cy = 1;         // in check
+            mc->reg_a  = mc->reg_f = 0xFF;
+            return;
+        }
+    }
+    mc->reg_cy = 0;
+    mc->reg_a  = mc->reg_f = 0x00;
+}
+
+// Steps along each MOVEX direction (MOVEN 1 to 10 hex) from each square
+//  (index rank*8+file) before leaving the board, worked out by the
+//  compiler; 0 if the first step leaves it. GNM takes only the steps
+//  these allow, so it never calls CMOVE for a square off the board
+#define RAY_AXIS(at,d)  ( (d)>0 ? (7-(at))/(d) : (d)<0 ? (at)/-(d) : 7 )
+#define RAY_MIN(a,b)    ( (a)<(b) ? (a) : (b) )
+#define RAY(sq,dx,dy)   RAY_MIN( RAY_AXIS((sq)&7,dx), RAY_AXIS((sq)>>3,dy) )
+#define RAY_SQUARE(sq)  { 0, RAY(sq, 0,-1), RAY(sq,-1, 0), RAY(sq, 1, 0),   \
+                             RAY(sq, 0, 1), RAY(sq, 1, 1), RAY(sq,-1, 1),   \
+                             RAY(sq,-1,-1), RAY(sq, 1,-1), RAY(sq,-1,-2),   \
+                             RAY(sq, 1,-2), RAY(sq,-2,-1), RAY(sq, 2,-1),   \
+                             RAY(sq, 2, 1), RAY(sq,-2, 1), RAY(sq,-1, 2),   \
+                             RAY(sq, 1, 2) }
+#define RAY_RANK(r)     RAY_SQUARE((r)*8),   RAY_SQUARE((r)*8+1),           \
+                        RAY_SQUARE((r)*8+2), RAY_SQUARE((r)*8+3),           \
+                        RAY_SQUARE((r)*8+4), RAY_SQUARE((r)*8+5),           \
+                        RAY_SQUARE((r)*8+6), RAY_SQUARE((r)*8+7)
+static const byte RAYS[64][17] = {  RAY_RANK(0), RAY_RANK(1), RAY_RANK(2),
+                                    RAY_RANK(3), RAY_RANK(4), RAY_RANK(5),
+                                    RAY_RANK(6), RAY_RANK(7)  };
+static const byte RAYS_NONE[17];    // for a captured piece
+
+// The steps from a square, on the board or not
+static const byte *rays( byte square )
+{
+    if( square & 0x88 )
+        return( RAYS_NONE );
+    return( RAYS[ (square>>4)*8 + (square&0x07) ] );
+}
+
+// CMOVE, N set (f=FF) if illegal, V if a capture, C if illegal because
+//  of check. X is left as the 6502 version leaves it. cmove_square() is
+//  CMOVE with the to square known to be on the board
+static void cmove_square( mc_engine *mc, byte square )
+{
+    byte piece = mc->mailbox[ square ^ mc->mailbox_sq ];
+
+    ZP(SQUARE) = square;
+    if( piece != EMPTY )
+        piece ^= mc->mailbox_pc;
+    mc->reg_x = piece;
+    if( piece == EMPTY || piece >= 0x10 )
+    {
+        mc->reg_v = (piece != EMPTY);
+        chkchk_native( mc );
+        return;
+    }
+    mc->reg_a  = mc->reg_f = 0xFF;  // our own piece
+    mc->reg_cy = 0;
+    mc->reg_v  = 0;
+}
+
+static void cmove_native( mc_engine *mc )
+{
+    byte square = ZP(SQUARE) + MOVEX[ZP(MOVEN)];
+
+    if( !(square & 0x88) )
+    {
+        cmove_square( mc, square );
+        return;
+    }
+    ZP(SQUARE) = square;            // off board
+    mc->reg_x  = ZP(MOVEN);
+    mc->reg_a  = mc->reg_f = 0xFF;
+    mc->reg_cy = 0;
+    mc->reg_v  = 0;
+}
+
+// CMOVE, counted, as GNM calls it for a step the rays allow
+static void native_cmove( mc_engine *mc )
+{
+    STAT( cmove );
+    cmove_square( mc, ZP(SQUARE) + MOVEX[ZP(MOVEN)] );
+}
+
+// SNGMV
+static void native_sngmv( mc_engine *mc, const byte *ray )
+{
+    if( ray[ZP(MOVEN)] )
+    {
+        native_cmove( mc );
+        if( !(mc->reg_f&0x80) )
+            JANUS( mc );
+        native_reset( mc );
+    }
+    ZP(MOVEN)--;
+}
+
+// LINE, nearest square first until blocked, a capture or the edge
+static void native_line( mc_engine *mc, const byte *ray )
+{
+    byte capture, steps;
+    for( steps=ray[ZP(MOVEN)]; steps; steps-- )
+    {
+        native_cmove( mc );
+        if( mc->reg_cy )
+        {
+            if( mc->reg_v )
+                break;              // can't capture, in check
+            continue;               // in check, but the line goes on
+        }
+        if( mc->reg_f & 0x80 )
+            break;
+        capture = mc->reg_v;
+        JANUS( mc );
+        if( capture )
+            break;
+    }
+    native_reset( mc );
+    ZP(MOVEN)--;
+}
+
+// GNM, pieces 0F down to 00, each in MOVEN order
+static void gnm_native( mc_engine *mc )
+{
+    const byte *ray;
+    byte piece;
+
+    ZP(PIECE) = 0x10;
+    while( !(--ZP(PIECE) & 0x80) )
+    {
+        native_reset( mc );
+        ZP(MOVEN) = 0x08;
+        piece = ZP(PIECE);
+        ray = rays( ZP(SQUARE) );
+        if( piece >= 0x08 )
+        {
+            for( ZP(MOVEN)=0x06; ZP(MOVEN)!=0x04; ZP(MOVEN)-- )
+            {
+                if( !ray[ZP(MOVEN)] )
+                    continue;
+                native_cmove( mc );             // captures
+                if( mc->reg_v && !(mc->reg_f&0x80) )
+                    JANUS( mc );
+                native_reset( mc );
+            }
+            if( ray[ZP(MOVEN)] )
+            {
+                do
+                {
+                    native_cmove( mc );         // ahead, once or
+                    if( mc->reg_v || (mc->reg_f&0x80) )
+                        break;
+                    JANUS( mc );
+                } while( (ZP(SQUARE)&0xF0) == 0x20 );   // twice from
+            }                                           //  2nd rank
+        }
+        else if( piece >= 0x06 )
+        {
+            ZP(MOVEN) = 0x10;
+            do
+                native_sngmv( mc, ray );
+            while( ZP(MOVEN) != 0x08 );
+        }
+        else if( piece >= 0x04 )
+        {
+            do
+                native_line( mc, ray );
+            while( ZP(MOVEN) != 0x04 );
+        }
+        else if( piece >= 0x02 )
+        {
+            ZP(MOVEN) = 0x04;
+            do
+                native_line( mc, ray );
+            while( ZP(MOVEN) );
+        }
+        else if( piece == 0x01 )
+        {
+            do
+                native_line( mc, ray );
+            while( ZP(MOVEN) );
+        }
+        else
+        {
+            do
+                native_sngmv( mc, ray );
+            while( ZP(MOVEN) );
+        }
+    }
+}
+
+// JANUS' counts (STATE 0 to 0C) in zero page "zp", returns 1 if the move
+//  isn't counted (black's best capture, as XRT)
+static int janus_count( mc_engine *mc, byte *zp )
+{
+    byte state = zp[STATE];
+    byte piece = zp[PIECE];
+    byte y, points;
+
+    if( piece && state == 0x08 && piece == zp[BMAXP] )
+        return( 1 );
+    zp[(byte)(MOB+state)]++;            // mobility, twice for
+    if( piece == 0x01 )                 //  the queen
+        zp[(byte)(MOB+state)]++;
+    if( mc->reg_v )
+    {
+        y = mailbox_find( mc, zp[SQUARE] ) - 0x10;
+        points = POINTS[y];
+        if( points >= zp[(byte)(MAXC+state)] )
+        {
+            zp[(byte)(PCAP+state)] = y; // best capture
+            zp[(byte)(MAXC+state)] = points;
+        }
+        zp[(byte)(CC+state)] += points;
+    }
+    return( 0 );
+}
+
+// JANUS
+static void janus_native( mc_engine *mc )
+{
+    byte state = ZP(STATE);
+    byte y;
+
+    if( !(state&0x80) )
+    {
+        if( janus_count( mc, mc->zeropage ) )
+            return;
+        if( state == 0x04 )
+        {
+            ZP(WCAP0) = ZP(XMAXC);      // ON4
+            if( !hash_on4( mc ) )
+            {
+                ZP(STATE) = 0x00;
+                MOVE( mc );             // replies
+                REVERSE( mc );
+                GNMZ( mc );
+                REVERSE( mc );
+                ZP(STATE) = 0x08;
+                GNM( mc );              // continuations
+                UMOVE( mc );
+                hash_on4_store( mc );
+            }
+            STRATGY( mc );
+            return;
+        }
+        if( !((byte)(state-0x04)&0x80) )
+            return;
+    }
+    else if( state == 0xF9 )
+    {
+        if( ZP(BK) == ZP(SQUARE) )
+            ZP(INCHEK) = 0x00;          // king can be taken
+        return;
+    }
+
+    // TREE, replies to a capture
+    if( !mc->reg_v )
+        return;
+    y = mailbox_find( mc, ZP(SQUARE) ) - 0x10;
+    if( y == 0 || y >= 0x08 )
+        return;                         // king or pawn
+    if( POINTS[y] >= ZP(BCAP0+state) )
+        ZP(BCAP0+state) = POINTS[y];
+    ZP(STATE)--;
+    if( mc->level2 != ZP(STATE) )
+    {
+        STAT( genrm );
+        if( mc->hash )
+            hash_genrm( mc );
+        else
+            GENRM( mc );
+    }
+    ZP(STATE)++;
+}
+
+// MOVE, the to square, captured piece (or FF), from square, piece and
+//  MOVEN are pushed on the second stack (SP2) for UMOVE
+static void move_native( mc_engine *mc )
+{
+    byte s = ZP(SP2);
+    byte piece = ZP(PIECE);
+    byte to = ZP(SQUARE);
+    byte from = ZP(BOARD+piece);
+    byte captured = mailbox_find( mc, to );
+
+    zobrist_move( mc, piece, from, to, captured );
+    mc->stack[s--] = to;
+    ZP(BOARD+captured) = 0xCC;          // (FF writes 4F, as the original)
+    mc->stack[s--] = captured;
+    ZP(BOARD+piece) = to;
+    mailbox_put( mc, from, EMPTY );
+    mailbox_put( mc, to, piece );
+    mc->stack[s--] = from;
+    mc->stack[s--] = piece;
+    mc->stack[s--] = ZP(MOVEN);
+    ZP(SP2) = s;
+    ZP(SP1) = mc->reg_s;
+    mc->reg_a = ZP(MOVEN);
+    mc->reg_y = to;
+    mc->reg_x = mc->reg_f = mc->reg_s;
+}
+
+// UMOVE
+static void umove_native( mc_engine *mc )
+{
+    byte s = ZP(SP2);
+    byte piece, captured, from, to;
+
+    ZP(MOVEN)  = mc->stack[++s];
+    ZP(PIECE)  = piece = mc->stack[++s];
+    from       = mc->stack[++s];
+    ZP(BOARD+piece) = from;
+    mailbox_put( mc, from, piece );
+    captured   = mc->stack[++s];
+    ZP(SQUARE) = to = mc->stack[++s];
+    ZP(BOARD+captured) = to;
+    mailbox_put( mc, to, captured );
+    zobrist_move( mc, piece, from, to, captured );
+    ZP(SP2) = s;
+    ZP(SP1) = mc->reg_s;
+    mc->reg_a = to;
+    mc->reg_x = mc->reg_f = mc->reg_s;
+}
+
+// REVERSE
+static void reverse_native( mc_engine *mc )
+{
+    byte bk0 = ZP(BK), t;
+    int i;
+
+    if( !reverse_vector( mc ) )
+    {
+        for( i=0; i<16; i++ )
+        {
+            t = ZP(BK+i);
+            ZP(BK+i) = 0x77 - ZP(BOARD+i);
+            ZP(BOARD+i) = 0x77 - t;
+        }
+        mc->reg_y  = bk0;
+        mc->reg_a  = ZP(BOARD);
+        mc->reg_cy = (0x77 >= bk0);
+        mc->reg_x  = mc->reg_f = 0xFF;
+    }
+    mc->mailbox_sq ^= 0x77;
+    mc->mailbox_pc ^= 0x10;
+    mc->key  ^= mc->rkey;
+    mc->rkey ^= mc->key;
+    mc->key  ^= mc->rkey;
+}
+
+// 8 bit add and subtract with carry, as ADC and SBC
+static byte native_adc( byte a, byte b, int *cy )
+{
+    unsigned int sum = a + b + *cy;
+    *cy = sum >> 8;
+    return( (byte)sum );
+}
+static byte native_sbc( byte a, byte b, int *cy )
+{
+    int difference = a - b - !*cy;
+    *cy = difference >= 0;
+    return( (byte)difference );
+}
+
+// STRATGY's value of the move, before CKMATE looks for mate
+static byte stratgy_native( mc_engine *mc )
+{
+    byte a, square = ZP(SQUARE), piece = ZP(PIECE);
+    int cy = 0;
+
+    a = native_adc( 0x80, ZP(WMOB), &cy );          // weight 0.25
+    a = native_adc( a, ZP(WMAXC), &cy );
+    a = native_adc( a, ZP(WCC), &cy );
+    a = native_adc( a, ZP(WCAP1), &cy );
+    a = native_adc( a, ZP(WCAP2), &cy );
+    cy = 1;
+    a = native_sbc( a, ZP(PMAXC), &cy );
+    a = native_sbc( a, ZP(PCC), &cy );
+    a = native_sbc( a, ZP(BCAP0), &cy );
+    a = native_sbc( a, ZP(BCAP1), &cy );
+    a = native_sbc( a, ZP(BCAP2), &cy );
+    a = native_sbc( a, ZP(PMOB), &cy );
+    a = native_sbc( a, ZP(BMOB), &cy );
+    if( !cy )
+        a = 0x00;                                   // underflow
+    cy = 0;
+    a = native_adc( a>>1, 0x40, &cy );              // weight 0.5
+    a = native_adc( a, ZP(WMAXC), &cy );
+    a = native_adc( a, ZP(WCC), &cy );
+    cy = 1;
+    a = native_sbc( a, ZP(BMAXC), &cy );
+    cy = 0;
+    a = native_adc( a>>1, 0x90, &cy );              // weight 1.0
+    a = native_adc( a, ZP(WCAP0), &cy );
+    a = native_adc( a, ZP(WCAP0), &cy );
+    a = native_adc( a, ZP(WCAP0), &cy );
+    a = native_adc( a, ZP(WCAP0), &cy );
+    a = native_adc( a, ZP(WCAP1), &cy );
+    cy = 1;
+    a = native_sbc( a, ZP(BMAXC), &cy );
+    a = native_sbc( a, ZP(BMAXC), &cy );
+    a = native_sbc( a, ZP(BMCC), &cy );
+    a = native_sbc( a, ZP(BMCC), &cy );
+    a = native_sbc( a, ZP(BCAP1), &cy );
+    if( square==0x33 || square==0x34 || square==0x22 || square==0x25 ||
+        (piece && ((byte)(ZP(BOARD+piece)-0x10)&0x80)) )
+        a += 0x02;                                  // position bonus
+    return( a );
+}
+
+// MC_NATIVE_COMPARE reports
+static void native_report( mc_engine *mc, const char *name )
+{
+    int i;
+    mc->native_mismatches++;
+    fprintf( stderr, "Native %s disagrees, state=%02x piece=%02x"
+                " square=%02x board", name, ZP(STATE), ZP(PIECE), ZP(SQUARE) );
+    for( i=0; i<32; i++ )
+        fprintf( stderr, " %02x", ZP(BOARD+i) );
+    fprintf( stderr, "\n" );
+}
+
+// Run one of CMOVE, MOVE, UMOVE or REVERSE both ways on copies of the
+//  engine and compare what they leave; the emulated version then runs
+//  for real
+static void native_compare( mc_engine *mc, const char *name,
+                            void (*native)( mc_engine *mc ),
+                            void (*emulated)( mc_engine *mc ) )
+{
+    mc_engine a = *mc, b = *mc;
+
+    a.native = b.native = MC_NATIVE_OFF;
+    emulated( &a );
+    native( &b );
+    if( memcmp( a.zeropage, b.zeropage, sizeof(a.zeropage) ) ||
+        memcmp( a.stack, b.stack, sizeof(a.stack) ) ||
+        memcmp( a.mailbox, b.mailbox, sizeof(a.mailbox) ) ||
+        a.mailbox_sq != b.mailbox_sq || a.mailbox_pc != b.mailbox_pc ||
+        a.key != b.key || a.rkey != b.rkey || a.reg_s != b.reg_s ||
+        a.reg_a != b.reg_a || a.reg_f != b.reg_f || a.reg_x != b.reg_x ||
+        a.reg_y != b.reg_y || a.reg_cy != b.reg_cy || a.reg_v != b.reg_v )
+        native_report( mc, name );
+}
+
+// JANUS, work out the counts the emulation should come to ...
+static void janus_compare( mc_engine *mc )
+{
+    mc->native_counted = !(ZP(STATE)&0x80);
+    if( mc->native_counted )
+    {
+        memcpy( mc->native_zp, mc->zeropage, sizeof(mc->native_zp) );
+        janus_count( mc, mc->native_zp );
+    }
+}
+
+// ... and check them once it has counted (at NOCAP)
+static void janus_check( mc_engine *mc )
+{
+    if( mc->native_counted &&
+        memcmp( mc->native_zp, mc->zeropage, sizeof(mc->native_zp) ) )
+        native_report( mc, "JANUS" );
+    mc->native_counted = 0;
+}
+
+// STRATGY, at NOPOSN the value is in A
+static void stratgy_check( mc_engine *mc )
+{
+    if( mc->reg_a != stratgy_native( mc ) )
+        native_report( mc, "STRATGY" );
+}
+
+// GNM, list the moves both versions offer JANUS, as gnm_compare()
+static void gnm_native_compare( mc_engine *mc )
+{
+    gen_list emulated, native;
+    int n;
+
+    emulated.n = native.n = 0;
+    mc->native = MC_NATIVE_OFF;
+    mc->record = &emulated;
+    GNM( mc );
+    mc->record = &native;
+    gnm_native( mc );
+    mc->record = NULL;
+    mc->native = MC_NATIVE_COMPARE;
+
+    n = emulated.n < MAX_GEN ? emulated.n : MAX_GEN;
+    if( emulated.n != native.n ||
+        memcmp( emulated.piece,   native.piece,   n ) ||
+        memcmp( emulated.square,  native.square,  n ) ||
+        memcmp( emulated.capture, native.capture, n ) )
+        native_report( mc, "GNM" );
+}
+
+
+//**********************************************************************
+//*
+//*  Part 16
+//*  -------
+//*  Time control. The original program took about 3, 10 and 100 seconds
+//*  a move at its three levels; here any level is far quicker, but how
+//*  much quicker depends on the machine, the position and the options
+//*  (threads, hash, native routines). So with a clock set, each search
+//*  measures what it cost, in JANUS calls and JANUS calls per second at
+//*  the level it ran at, and mc_go() plays at the strongest level whose
+//*  predicted time fits the share of the clock this move may use. A level
+//*  not yet measured is predicted from a measured one using the original
+//*  timings' ratios, and until any is measured the weakest is used
+//**********************************************************************
+
+#define CLOCK_MOVES     30      // moves left assumed if not told
+#define CLOCK_MARGIN    0.05    // seconds kept back for the host
+#define CLOCK_WEIGHT    0.3     // of the latest search in the averages
+
+// Set the clock, "remaining" seconds for the rest of the game (or until
+//  "moves_to_go" more moves have been made, 0 if unknown) plus
+//  "increment" seconds for each move. mc_go() then chooses the level,
+//  and takes the time it used off the clock (adding the increment), so a
+//  host may set the clock once or before each move. MC_CLOCK_OFF goes
+//  back to the level set by mc_set_level()
+int mc_set_clock( mc_engine *mc, double remaining, double increment,
+                                                        int moves_to_go )
+{
+    if( remaining < 0 )
+    {
+        mc->clock_on = 0;
+        level_set( mc, mc->fixed_level );
+        return( MC_OK );
+    }
+    if( increment < 0 || moves_to_go < 0 )
+        return( MC_ERROR );
+    mc->clock_on        = 1;
+    mc->clock_remaining = remaining;
+    mc->clock_increment = increment;
+    mc->clock_moves     = moves_to_go;
+    return( MC_OK );
+}
+
+// Seconds a search at "level" should take, or -1 if nothing is known
+static double clock_predict( mc_engine *mc, int level )
+{
+    static const double original[4] = { 0, 3, 10, 100 };
+    int other;
+
+    if( mc->clock_rate[level] > 0 )
+        return( mc->clock_nodes[level] / mc->clock_rate[level] );
+    for( other=level-1; other>=MC_LEVEL_SUPER_BLITZ; other-- )
+    {
+        if( mc->clock_rate[other] > 0 )
+            break;
+    }
+    if( other < MC_LEVEL_SUPER_BLITZ )
+    {
+        for( other=level+1; other<=MC_LEVEL_NORMAL; other++ )
+        {
+            if( mc->clock_rate[other] > 0 )
+                break;
+        }
+        if( other > MC_LEVEL_NORMAL )
+            return( -1 );
+    }
+    return( mc->clock_nodes[other] / mc->clock_rate[other]
+                                        * original[level] / original[other] );
+}
+
+// Before a search, the strongest level that fits this move's share
+static void clock_choose( mc_engine *mc )
+{
+    double left = mc->clock_remaining - CLOCK_MARGIN;
+    double budget, predicted;
+    int level;
+
+    budget = left / (mc->clock_moves ? mc->clock_moves : CLOCK_MOVES)
+                                            + mc->clock_increment * 0.75;
+    if( budget > left / 2 )
+        budget = left / 2;
+    for( level=MC_LEVEL_NORMAL; level>MC_LEVEL_SUPER_BLITZ; level-- )
+    {
+        predicted = clock_predict( mc, level );
+        if( predicted >= 0 && predicted <= budget )
+            break;
+    }
+    level_set( mc, level );
+}
+
+// After a search, what it cost, and the clock
+static void clock_measure( mc_engine *mc, double elapsed )
+{
+    double nodes = (double)mc->stats.janus;
+    double seconds = mc->stats.seconds;
+    int level = mc->level;
+
+    mc->clock_remaining += mc->clock_increment - elapsed;
+    if( mc->clock_remaining < 0 )
+        mc->clock_remaining = 0;
+    if( mc->clock_moves > 1 )
+        mc->clock_moves--;
+    if( seconds <= 0 )
+        return;                     // opening book, nothing searched
+    if( nodes == 0 )
+        nodes = seconds;            // no counters (MC_NO_STATS), time alone
+    if( mc->clock_rate[level] > 0 )
+    {
+        mc->clock_nodes[level] += CLOCK_WEIGHT *
+                                    (nodes - mc->clock_nodes[level]);
+        mc->clock_rate[level]  += CLOCK_WEIGHT *
+                                    (nodes/seconds - mc->clock_rate[level]);
+    }
+    else
+    {
+        mc->clock_nodes[level] = nodes;
+        mc->clock_rate[level]  = nodes / seconds;
+    }
+}
+
+
+//**********************************************************************
+//*
+//*  Part 17
+//*  -------
+//*  Capture tree pruning. TREE follows a capture of a piece (not a pawn
+//*  or the king) with every reply, down to level2, only to raise each of
+//*  the counters BCAP0+STATE to the best capture seen at that depth. It
+//*  is a maximum per depth rather than a minimax, so the order replies
+//*  are looked at in doesn't matter, only which are looked at. Replies
+//*  other than such captures do nothing there, so GENRM need only list
+//*  the captures, most valuable victim first (POINTS). And a capture can
+//*  be passed over once the counter at its depth is already as good as
+//*  its victim and every deeper counter is already as good as the best
+//*  piece the side captured at that depth has left, as nothing below it
+//*  could then raise a counter; the captures after it, taking no more,
+//*  are passed over with it. The counters come out exactly as before,
+//*  with far fewer nodes. MC_PRUNE_COMPARE runs both and reports any
+//*  difference; MC_PRUNE_OFF is the original alone
+//**********************************************************************
+
+#define TREE_MAX        128     // captures of pieces in one position
+
+typedef struct tree_capture
+{
+    byte piece, square, points;
+} tree_capture;
+
+// The captures of BK's pieces (not pawns or the king) the side to move
+//  has, as GNM offers them to JANUS, most valuable victim first
+static int tree_captures( mc_engine *mc, tree_capture *list )
+{
+    tree_capture capture;
+    byte piece, from, to, victim, moven, last;
+    int n=0, i, line;
+
+    for( piece=0; piece<0x10; piece++ )
+    {
+        from = ZP(BOARD+piece);
+        if( from & 0x88 )
+            continue;                   // captured
+        line = 0;
+        if( piece >= 0x08 )
+            moven = 0x06, last = 0x05;  // pawns take diagonally
+        else if( piece >= 0x06 )
+            moven = 0x10, last = 0x09;
+        else if( piece >= 0x04 )
+            moven = 0x08, last = 0x05, line = 1;
+        else if( piece >= 0x02 )
+            moven = 0x04, last = 0x01, line = 1;
+        else
+            moven = 0x08, last = 0x01, line = (piece==0x01);
+        for( ; moven>=last; moven-- )
+        {
+            to = from;
+            do
+            {
+                to += MOVEX[moven];
+                victim = mailbox_find( mc, to );
+            } while( line && victim==EMPTY && !(to&0x88) );
+            if( victim<=0x10 || victim>=0x18 )
+                continue;               // empty, own, king or pawn
+            capture.piece  = piece;
+            capture.square = to;
+            capture.points = POINTS[victim-0x10];
+            for( i=n++; i>0 && list[i-1].points<capture.points; i-- )
+                list[i] = list[i-1];
+            list[i] = capture;
+        }
+    }
+    return( n );
+}
+
+// Best piece (not a pawn or the king) BOARD (side 0x00) or BK (0x10) has
+//  left to lose
+static byte tree_bound( mc_engine *mc, byte side )
+{
+    byte i;
+    for( i=1; i<8; i++ )
+    {
+        if( !(ZP(BOARD+side+i) & 0x88) )
+            return( POINTS[i] );
+    }
+    return( 0 );
+}
+
+// Can nothing deeper than STATE raise a counter ? BOARD loses pieces at
+//  STATE-1, BK at STATE-2 and so on down to level2+1
+static int tree_full( mc_engine *mc, const byte bound[2] )
+{
+    byte state = ZP(STATE) - 1;
+    int side = 0;
+
+    for( ; state!=mc->level2; state--, side^=1 )
+    {
+        if( ZP(BCAP0+state) < bound[side] )
+            return( 0 );
+    }
+    return( 1 );
+}
+
+// GENRM, the captures in reply to PIECE taking on SQUARE, best first
+//  until nothing more can be found
+static void genrm_pruned( mc_engine *mc )
+{
+    tree_capture list[TREE_MAX];
+    byte bound[2];
+    int i, n;
+
+    JSR( MOVE );
+    JSR( REVERSE );
+    n = tree_captures( mc, list );
+    bound[0] = tree_bound( mc, 0x00 );
+    bound[1] = tree_bound( mc, 0x10 );
+    for( i=0; i<n; i++ )
+    {
+        if( ZP(BCAP0+ZP(STATE)) >= list[i].points && tree_full(mc,bound) )
+            break;
+        ZP(PIECE)  = list[i].piece;
+        ZP(SQUARE) = list[i].square;
+        mc->reg_v  = 1;
+        JSR( JANUS );
+    }
+    JSR( REVERSE );
+    JSR( UMOVE );
+}
+
+// GENRM both ways, the pruned version on a copy of the engine, and
+//  compare the counters (and all else) they leave
+static void genrm_compare( mc_engine *mc )
+{
+    mc_engine *pruned = (mc_engine *)malloc( sizeof(mc_engine) );
+
+    if( pruned == NULL )
+    {
+        JSR( GENRM );               // can't compare, just search
+        return;
+    }
+    *pruned = *mc;
+    pruned->pruning = MC_PRUNE_ON;
+    genrm_pruned( pruned );
+    mc->pruning = MC_PRUNE_OFF;
+    JSR( GENRM );
+    mc->pruning = MC_PRUNE_COMPARE;
+    if( memcmp( mc->zeropage, pruned->zeropage, sizeof(mc->zeropage) ) ||
+        memcmp( mc->mailbox, pruned->mailbox, sizeof(mc->mailbox) ) ||
+        mc->key != pruned->key || mc->rkey != pruned->rkey ||
+        mc->reg_s != pruned->reg_s )
+    {
+        mc->pruning_mismatches++;
+        fprintf( stderr, "Pruned capture tree disagrees, state=%02x"
+                    " piece=%02x square=%02x\n", ZP(STATE), ZP(PIECE),
+                    ZP(SQUARE) );
+    }
+    free( pruned );
+}
+
+
+//**********************************************************************
+//*
+//*  Part 18
+//*  -------
+//*  Opening book file. The original book is one line of play, OPNING,
+//*  dropped for good as soon as the opponent leaves it. A book file
+//*  instead holds any number of lines as positions, each keyed by a hash
+//*  of where the pieces stand and whose move it is (mc_book_key()), with
+//*  weighted moves; so transpositions are found, and a game that left one
+//*  line can come back into another. The file is sorted by key, mapped
+//*  read only and shared by every engine that uses it, and looked up by
+//*  binary search; a position found is played at once without a search.
+//*  Build one with microchess-book. The layout, all little endian:
+//*
+//*      header   "MCBOOK01", entry count (4 bytes), spare (4 bytes)
+//*      entry    key (8 bytes), move eg "e2e4" (4 bytes), weight (2
+//*               bytes), spare (2 bytes)
+//**********************************************************************
+
+#define BOOK_MAGIC      "MCBOOK01"
+#define BOOK_HEADER     16
+#define BOOK_ENTRY      16
+
+struct book_file
+{
+    char *path;
+    const byte *data;           // the file, mapped
+    size_t size;
+    unsigned long entries;
+    int users;                  // engines using it
+    book_file *next;
+};
+
+static book_file *books;        // every book file mapped
+static pthread_mutex_t book_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Little endian number of "n" bytes in the file
+static unsigned long long book_read( const byte *data, int n )
+{
+    unsigned long long value = 0;
+    while( n-- )
+        value = value<<8 | data[n];
+    return( value );
+}
+
+// Key for one piece (colour, kind 0-5 for KQRBNP and square 0-63) or,
+//  with index 768, for black to move. Fixed for all time, as book files
+//  depend on them
+static unsigned long long book_hash( int index )
+{
+    unsigned long long z = (index+1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z>>30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z>>27)) * 0x94D049BB133111EBULL;
+    return( z ^ (z>>31) );
+}
+
+// Book key of the position, the computer to move. Unlike the Zobrist key
+//  (Part 13) it doesn't depend on which slot a piece is in or which side
+//  the computer plays, only on the colours and squares of the pieces
+unsigned long long mc_book_key( mc_engine *mc )
+{
+    unsigned long long key = ZP(REV) ? book_hash(768) : 0;
+    int i, black, kind, file, rank;
+    byte square;
+
+    for( i=0; i<MC_PIECES; i++ )
+    {
+        square = ZP(BOARD+i);
+        if( square & 0x88 )
+            continue;                   // captured
+        black = (i<0x10) == (ZP(REV)!=0);
+        kind  = "0122334455555555"[i&0x0f] - '0';
+        file  = algebraic_file( mc, square ) - 'a';
+        rank  = algebraic_rank( mc, square ) - '1';
+        key  ^= book_hash( (black*6+kind)*64 + rank*8+file );
+    }
+    return( key );
+}
+
+// Stop using the engine's book, unmapping it if no engine needs it
+static void book_detach( mc_engine *mc )
+{
+    book_file **b, *book = mc->book;
+
+    if( book == NULL )
+        return;
+    mc->book = NULL;
+    pthread_mutex_lock( &book_lock );
+    if( --book->users == 0 )
+    {
+        for( b=&books; *b!=book; b=&(*b)->next )
+            ;
+        *b = book->next;
+        munmap( (void *)book->data, book->size );
+        free( book->path );
+        free( book );
+    }
+    pthread_mutex_unlock( &book_lock );
+}
+
+// Map a book file, NULL if it can't be or isn't one
+static book_file *book_map( const char *path )
+{
+    book_file *book;
+    struct stat st;
+    void *data;
+    int fd;
+
+    fd = open( path, O_RDONLY );
+    if( fd < 0 )
+        return( NULL );
+    if( fstat(fd,&st) != 0 || st.st_size < BOOK_HEADER )
+    {
+        close( fd );
+        return( NULL );
+    }
+    data = mmap( NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    close( fd );
+    if( data == MAP_FAILED )
+        return( NULL );
+    book = (book_file *)calloc( 1, sizeof(book_file) );
+    if( book == NULL || memcmp( data, BOOK_MAGIC, 8 ) ||
+        (size_t)st.st_size < BOOK_HEADER +
+                    book_read( (byte *)data+8, 4 ) * BOOK_ENTRY ||
+        NULL == (book->path = strdup(path)) )
+    {
+        free( book );
+        munmap( data, (size_t)st.st_size );
+        return( NULL );
+    }
+    book->data    = (const byte *)data;
+    book->size    = (size_t)st.st_size;
+    book->entries = (unsigned long)book_read( book->data+8, 4 );
+    return( book );
+}
+
+// Use the book file at "path" for the engine's moves, from the next GO,
+//  in place of the original canned opening; NULL for no book file.
+//  Returns MC_ERROR (and leaves the engine without one) if it can't be
+//  read
+int mc_set_book( mc_engine *mc, const char *path )
+{
+    book_file *book;
+
+    book_detach( mc );
+    if( path == NULL )
+        return( MC_OK );
+    pthread_mutex_lock( &book_lock );
+    for( book=books; book; book=book->next )
+    {
+        if( 0 == strcmp(book->path,path) )
+            break;
+    }
+    if( book == NULL && NULL != (book=book_map(path)) )
+    {
+        book->next = books;
+        books = book;
+    }
+    if( book )
+        book->users++;
+    pthread_mutex_unlock( &book_lock );
+    mc->book = book;
+    return( book ? MC_OK : MC_ERROR );
+}
+
+// Seed the choice between weighted book moves, the same seed making the
+//  same choices
+void mc_seed_book( mc_engine *mc, unsigned long seed )
+{
+    mc->book_random = book_hash( (int)(seed & 0x7fffffff) ) | 1;
+}
+
+// GO, look the position up in the book file and choose one of its moves
+//  by weight. Returns 0 if there isn't one (or it isn't playable here),
+//  otherwise the move is left in DIS1 (piece) and DIS3 (to square)
+static int book_move( mc_engine *mc )
+{
+    const byte *entry = mc->book->data + BOOK_HEADER;
+    unsigned long long key = mc_book_key( mc ), total=0, pick;
+    unsigned long lo=0, hi=mc->book->entries, i;
+    unsigned char from, to;
+    char text[5];
+    byte piece, victim;
+
+    while( lo < hi )                    // first entry for the key
+    {
+        i = lo + (hi-lo)/2;
+        if( book_read( entry+i*BOOK_ENTRY, 8 ) < key )
+            lo = i+1;
+        else
+            hi = i;
+    }
+    for( hi=lo; hi<mc->book->entries &&
+                    book_read(entry+hi*BOOK_ENTRY,8)==key; hi++ )
+        total += book_read( entry+hi*BOOK_ENTRY+12, 2 );
+    if( total == 0 )
+        return( 0 );
+    mc->book_random ^= mc->book_random << 13;
+    mc->book_random ^= mc->book_random >> 7;
+    mc->book_random ^= mc->book_random << 17;
+    pick = mc->book_random % total;
+    for( i=lo; pick >= book_read(entry+i*BOOK_ENTRY+12,2); i++ )
+        pick -= book_read( entry+i*BOOK_ENTRY+12, 2 );
+
+    memcpy( text, entry+i*BOOK_ENTRY+8, 4 );
+    text[4] = '\0';
+    if( MC_OK != mc_parse_move( mc, text, &from, &to ) )
+        return( 0 );
+    piece  = mailbox_find( mc, from );
+    victim = mailbox_find( mc, to );
+    if( piece >= 0x10 || (victim != EMPTY && victim < 0x10) )
+        return( 0 );                    // not the computer's to make
+    ZP(DIS1) = piece;
+    ZP(DIS3) = to;
+    return( 1 );
+}
@@ -0,0 +1,169 @@
+//***********************************************************************
+//
+//  Kim-1 MicroChess (c) 1976-2005 Peter Jennings, www.benlo.com
+//  6502 emulation   (c) 2005 Bill Forster
+//
+//  Embedding interface to the microchess engine. Each mc_engine is a
+//  complete, independent 6502 emulation, so a host can run as many games
+//  as it likes, one engine per thread.
+//
+//***********************************************************************
+
+#ifndef MICROCHESS_H
+#define MICROCHESS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct mc_engine mc_engine;
+
+// Squares use the microchess grid, 0xRF with rank R and file F 0-7, rank
+//  0 being the computer's back rank. Pieces 0x00-0x0f are the computer's,
+//  0x10-0x1f the opponent's, each set in the order KQRRBBNNPPPPPPPP
+#define MC_PIECES       32
+#define MC_CAPTURED     0xcc    // square of a piece no longer on the board
+
+// Longest FEN mc_get_fen() writes, with its terminating '\0'
+#define MC_FEN_MAX      100
+
+// Search levels, as the "ln" command
+#define MC_LEVEL_SUPER_BLITZ    1
+#define MC_LEVEL_BLITZ          2
+#define MC_LEVEL_NORMAL         3
+
+// Turns the clock off, see mc_set_clock()
+#define MC_CLOCK_OFF    (-1.0)
+
+// Move generators, see mc_set_generator()
+#define MC_GEN_6502     0       // the original, emulated GNM
+#define MC_GEN_BITBOARD 1       // bitboard generator, same moves
+#define MC_GEN_COMPARE  2       // run both, report any difference
+
+// Hot routines run as, see mc_set_native()
+#define MC_NATIVE_OFF       0   // the 6502 emulation throughout
+#define MC_NATIVE_ON        1   // C versions, same results (the default)
+#define MC_NATIVE_COMPARE   2   // run both, report any difference
+
+// Capture tree searched as, see mc_set_pruning()
+#define MC_PRUNE_OFF        0   // every reply generated, as the original
+#define MC_PRUNE_ON         1   // captures only, best first, cut off (default)
+#define MC_PRUNE_COMPARE    2   // run both, report any difference
+
+// Most threads GO may search with, see mc_set_threads()
+#define MC_MAX_THREADS  64
+
+// Transposition table megabytes a new engine has, see mc_set_hash()
+#define MC_HASH_DEFAULT 4
+
+// Return codes
+#define MC_OK           0
+#define MC_ERROR        (-1)
+#define MC_MATE         1       // no move to play, resign or stalemate
+#define MC_EXIT         2       // [Q] command, see mc_step()
+
+// A move chosen by mc_go(); value is the score GO assigned to the move
+//  (higher is better for the computer, 0 for an opening book move)
+typedef struct mc_move
+{
+    unsigned char piece;
+    unsigned char from;
+    unsigned char to;
+    unsigned char value;
+} mc_move;
+
+// What the last search (mc_go() or the "p" command) did, see
+//  mc_get_stats(). janus_state splits the JANUS calls by STATE: 0C the
+//  opponent's moves in the current position, 04 the program's moves, 00
+//  the replies to them, 08 the continuations, F9 the replies generated
+//  by CHKCHK (only with MC_GEN_COMPARE, it normally looks for attacks
+//  on the king instead) and FF down to the level's limit the capture
+//  tree (TREE)
+typedef struct mc_stats
+{
+    unsigned long long janus;           // moves JANUS analysed
+    unsigned long long janus_state[256];
+    unsigned long long cmove;           // CMOVE calls (original generator)
+    unsigned long long chkchk;          // check tests made by CHKCHK
+    unsigned long long gnm;             // move generations (GNM calls)
+    unsigned long long move;            // MOVE calls, each undone by UMOVE
+    unsigned long long reverse;         // REVERSE calls
+    unsigned long long genrm;           // capture tree recursions (GENRM)
+    unsigned long long hash_probes;     // transposition table look ups
+    unsigned long long hash_hits;       // ... that found the result
+    double seconds;                     // time taken by the search
+} mc_stats;
+
+// Engine lifetime
+mc_engine *mc_create( void );
+void mc_destroy( mc_engine *mc );
+
+// Position set up
+void mc_new_game( mc_engine *mc, int computer_white );
+void mc_set_position( mc_engine *mc, const unsigned char squares[MC_PIECES],
+                                                            int reversed );
+int  mc_get_position( mc_engine *mc, unsigned char squares[MC_PIECES] );
+int  mc_set_fen( mc_engine *mc, const char *fen );
+void mc_get_fen( mc_engine *mc, char fen[MC_FEN_MAX] );
+void mc_reverse( mc_engine *mc );
+
+// Play
+int  mc_set_level( mc_engine *mc, int level );
+int  mc_get_level( mc_engine *mc );
+int  mc_set_clock( mc_engine *mc, double remaining, double increment,
+                                                        int moves_to_go );
+int  mc_set_threads( mc_engine *mc, int threads );
+int  mc_set_hash( mc_engine *mc, int megabytes );
+void mc_clear_hash( mc_engine *mc );
+int  mc_set_generator( mc_engine *mc, int generator );
+long mc_generator_mismatches( mc_engine *mc );
+int  mc_set_native( mc_engine *mc, int mode );
+long mc_native_mismatches( mc_engine *mc );
+int  mc_set_pruning( mc_engine *mc, int mode );
+long mc_pruning_mismatches( mc_engine *mc );
+int  mc_set_book( mc_engine *mc, const char *path );
+void mc_seed_book( mc_engine *mc, unsigned long seed );
+unsigned long long mc_book_key( mc_engine *mc );
+int  mc_apply_move( mc_engine *mc, unsigned char from, unsigned char to );
+int  mc_go( mc_engine *mc, mc_move *best );
+void mc_move_text( mc_engine *mc, const mc_move *move, char text[5] );
+int  mc_parse_move( mc_engine *mc, const char *text, unsigned char *from,
+                                                        unsigned char *to );
+void mc_get_stats( mc_engine *mc, mc_stats *stats );
+
+// Perft, count positions "depth" moves deep from the current board (the
+//  computer to move), optionally reporting the count below each move
+typedef void (*mc_divide_fn)( void *ctx, const mc_move *move,
+                                            unsigned long long nodes );
+unsigned long long mc_perft( mc_engine *mc, int depth, int legal,
+                                        mc_divide_fn divide, void *ctx );
+
+// Microbenchmark of one routine of the search on the current board,
+//  "which" from 0 until MC_ERROR is returned
+typedef struct mc_timing
+{
+    const char *name;       // routine(s) timed
+    unsigned long ops;      // calls per sample
+    int samples;
+    double ns_per_op;       // mean over the samples
+    double ns_stddev;       // standard deviation between samples
+    double ns_min;          // fastest sample
+} mc_timing;
+int  mc_microbench( mc_engine *mc, int which, int samples, mc_timing *timing );
+
+// Primitive command interface, one key of the original program per call
+int  mc_step( mc_engine *mc, int key );
+
+// Interactive text interface on stdin/stdout (the original program),
+//  returns 0 when it exits, 1 if out of memory
+int  mc_console( mc_engine *mc );
+
+// Line oriented engine protocol on stdin/stdout, UCI style (uci, isready,
+//  ucinewgame, setoption, position, go, stop, quit), no board display
+int  mc_protocol( mc_engine *mc );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MICROCHESS_H